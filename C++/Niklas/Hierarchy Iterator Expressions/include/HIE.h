@@ -45,14 +45,233 @@
 #include <ge_dynamicarray.h>
 #include <cstring>
 
+/**
+ * Type identifiers returned by HIE_BaseNode::GetType(). They allow
+ * other modules to inspect a compiled tree without RTTI.
+ */
+enum {
+    HIE_NODE_UNKNOWN,
+    HIE_NODE_NEXT,
+    HIE_NODE_PRED,
+    HIE_NODE_UP,
+    HIE_NODE_DOWN,
+    HIE_NODE_CACHE,
+    HIE_NODE_OR,
+    HIE_NODE_CONTAINER,
+    HIE_NODE_REPEAT,
+    HIE_NODE_STEP,
+    HIE_NODE_FILTER,
+};
+
+/**
+ * A block of memory that objects are allocated from one after another.
+ * Objects in an arena are never deallocated individually, the whole
+ * block is freed at once.
+ */
+class HIE_Arena {
+
+    /**
+     * The memory block.
+     */
+    char* block;
+
+    /**
+     * The size of the block in bytes.
+     */
+    LONG size;
+
+    /**
+     * The number of bytes handed out.
+     */
+    LONG used;
+
+    /**
+     * TRUE when the block was allocated by the arena.
+     */
+    Bool owned;
+
+    public:
+
+    /**
+     * The alignment of memory handed out by Alloc().
+     */
+    static const LONG ALIGNMENT = 8;
+
+    /**
+     * Initialize an arena without a block.
+     */
+    HIE_Arena() : block(NULL), size(0), used(0), owned(FALSE) {}
+
+    /**
+     * Destructor.
+     */
+    ~HIE_Arena() {
+        Free();
+    }
+
+    /**
+     * Allocate a new block for the arena, freeing the previous one.
+     * @param size The size of the block in bytes.
+     * @return TRUE on success, FALSE if not.
+     */
+    Bool Init(LONG size) {
+        Free();
+        block = (char*) GeAlloc(size);
+        if (!block) return FALSE;
+        this->size = size;
+        owned = TRUE;
+        return TRUE;
+    }
+
+    /**
+     * Use memory owned by the caller for the arena, freeing the
+     * previous block. The memory must outlive the arena.
+     * @param memory The memory, aligned to ALIGNMENT.
+     * @param size The size of the memory in bytes.
+     */
+    void Init(void* memory, LONG size) {
+        Free();
+        block = (char*) memory;
+        this->size = size;
+    }
+
+    /**
+     * Free the block of the arena. Invalidates every object allocated
+     * from it.
+     */
+    void Free() {
+        if (block && owned) GeFree(block);
+        block = NULL;
+        size = 0;
+        used = 0;
+        owned = FALSE;
+    }
+
+    /**
+     * Transfer the block of another arena to this arena.
+     * @param other The arena to take the block from. Empty afterwards.
+     */
+    void Take(HIE_Arena& other) {
+        Free();
+        block = other.block;
+        size = other.size;
+        used = other.used;
+        owned = other.owned;
+        other.block = NULL;
+        other.size = 0;
+        other.used = 0;
+        other.owned = FALSE;
+    }
+
+    /**
+     * Hand out memory from the arena.
+     * @param bytes The number of bytes.
+     * @return The memory, aligned to ALIGNMENT, or NULL if the arena
+     * is exhausted.
+     */
+    void* Alloc(LONG bytes) {
+        LONG offset = (used + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+        if (!block || bytes > size - offset) return NULL;
+        used = offset + bytes;
+        return block + offset;
+    }
+
+    /**
+     * @return TRUE when the arena has a block.
+     */
+    Bool IsInit() const {
+        return block != NULL;
+    }
+
+    /**
+     * @return The number of bytes handed out.
+     */
+    LONG GetUsed() const {
+        return used;
+    }
+
+    /**
+     * @return The size of the block in bytes.
+     */
+    LONG GetSize() const {
+        return size;
+    }
+
+};
+
+/**
+ * Receives the nodes yielded by HIE_BaseNode::Enumerate().
+ */
+class HIE_Sink {
+
+    public:
+
+    /**
+     * Destructor.
+     */
+    virtual ~HIE_Sink() {
+    }
+
+    /**
+     * Called for every node yielded by an expression.
+     * @param node The node. Never NULL.
+     * @return TRUE to continue, FALSE to stop the enumeration.
+     */
+    virtual Bool Push(GeListNode* node) = 0;
+
+};
+
+/**
+ * Forwards nodes to another sink and counts them.
+ */
+class HIE_CountingSink : public HIE_Sink {
+
+    public:
+
+    /**
+     * The sink the nodes are forwarded to.
+     */
+    HIE_Sink* sink;
+
+    /**
+     * The number of nodes forwarded.
+     */
+    LONG count;
+
+    HIE_CountingSink(HIE_Sink* sink) : sink(sink), count(0) {}
+
+    /* Override: HIE_Sink */
+    Bool Push(GeListNode* node) {
+        count++;
+        return sink->Push(node);
+    }
+
+};
+
 /**
  * This is the base class evaluating a single instruction in an
  * expression.
+ *
+ * Evaluating a node never modifies it. Once compiled, a node tree
+ * may be evaluated from any number of threads at the same time as long
+ * as it is not modified (e.g. by HIE_Container::Push()) or deleted
+ * while doing so. Subclasses must keep this guarantee.
  */
 class HIE_BaseNode {
 
+    /**
+     * The position of the node in the expression it was compiled
+     * from, -1 if unknown.
+     */
+    LONG position;
+
     public:
 
+    /**
+     * Initialize the node without a position.
+     */
+    HIE_BaseNode() : position(-1) {}
+
     /**
      * Returns the next node relative to the passed node.
      * @param node The node that should be used for finding the next
@@ -61,6 +280,72 @@ class HIE_BaseNode {
      */
     virtual GeListNode* GetNextNode(GeListNode* node) const = 0;
 
+    /**
+     * Evaluates the node for a batch of nodes. Subclasses override
+     * this to apply each instruction to the whole batch before moving
+     * on to the next one.
+     * @param input The nodes to start from. NULL entries yield NULL.
+     * @param output Receives the resulting nodes. May be equal to
+     * `input`.
+     * @param count The number of nodes in the batch.
+     */
+    virtual void GetNextNodes(GeListNode* const* input, GeListNode** output,
+                              LONG count) const {
+        LONG index = 0;
+        for (; index < count; index++) {
+            GeListNode* node = input[index];
+            output[index] = node ? GetNextNode(node) : NULL;
+        }
+    }
+
+    /**
+     * Yields every node the expression reaches from the passed node,
+     * as opposed to GetNextNode() which returns a single node. Nodes
+     * are passed to the sink as soon as they are found. Without
+     * repetition operators, an expression yields at most one node,
+     * the one returned by GetNextNode().
+     * @param node The node to start from. Assumed to be not NULL.
+     * @param sink Receives the nodes.
+     * @return FALSE when the sink stopped the enumeration, TRUE if not.
+     */
+    virtual Bool Enumerate(GeListNode* node, HIE_Sink* sink) const {
+        GeListNode* dest = GetNextNode(node);
+        return dest ? sink->Push(dest) : TRUE;
+    }
+
+    /**
+     * @return TRUE when Enumerate() may yield more than one node.
+     */
+    virtual Bool IsMultiValued() const {
+        return FALSE;
+    }
+
+    /**
+     * @return The type identifier of the node. Custom subclasses
+     * return HIE_NODE_UNKNOWN.
+     */
+    virtual LONG GetType() const {
+        return HIE_NODE_UNKNOWN;
+    }
+
+    /**
+     * @return The position of the node in the expression it was
+     * compiled from, counted in characters, or -1 if unknown. Groups
+     * and filters start at their opening character, operators are at
+     * the operator character.
+     */
+    LONG GetPosition() const {
+        return position;
+    }
+
+    /**
+     * Set the position of the node in its expression.
+     * @param position The position, -1 if unknown.
+     */
+    void SetPosition(LONG position) {
+        this->position = position;
+    }
+
     /**
      * Destructor.
      */
@@ -83,6 +368,20 @@ class HIE_BaseNode {
         GeFree(p);
     }
 
+    /**
+     * Allocator for an instance in a HIE_Arena. Nodes allocated this
+     * way must not be deleted, they are freed with the arena.
+     */
+    void* operator new (size_t size, HIE_Arena* arena) throw() {
+        return arena->Alloc((LONG) size);
+    }
+
+    /**
+     * Matches the arena allocator, nothing to do.
+     */
+    void operator delete (void* p, HIE_Arena* arena) {
+    }
+
 };
 
 /**
@@ -98,6 +397,21 @@ class HIE_NextNode : public HIE_BaseNode {
         return node->GetNext();
     }
 
+    /* Override: HIE_BaseNode */
+    void GetNextNodes(GeListNode* const* input, GeListNode** output,
+                      LONG count) const {
+        LONG index = 0;
+        for (; index < count; index++) {
+            GeListNode* node = input[index];
+            output[index] = node ? node->GetNext() : NULL;
+        }
+    }
+
+    /* Override: HIE_BaseNode */
+    LONG GetType() const {
+        return HIE_NODE_NEXT;
+    }
+
 };
 
 /**
@@ -113,6 +427,21 @@ class HIE_PredNode : public HIE_BaseNode {
         return node->GetPred();
     }
 
+    /* Override: HIE_BaseNode */
+    void GetNextNodes(GeListNode* const* input, GeListNode** output,
+                      LONG count) const {
+        LONG index = 0;
+        for (; index < count; index++) {
+            GeListNode* node = input[index];
+            output[index] = node ? node->GetPred() : NULL;
+        }
+    }
+
+    /* Override: HIE_BaseNode */
+    LONG GetType() const {
+        return HIE_NODE_PRED;
+    }
+
 };
 
 /**
@@ -128,6 +457,21 @@ class HIE_UpNode : public HIE_BaseNode {
         return node->GetUp();
     }
 
+    /* Override: HIE_BaseNode */
+    void GetNextNodes(GeListNode* const* input, GeListNode** output,
+                      LONG count) const {
+        LONG index = 0;
+        for (; index < count; index++) {
+            GeListNode* node = input[index];
+            output[index] = node ? node->GetUp() : NULL;
+        }
+    }
+
+    /* Override: HIE_BaseNode */
+    LONG GetType() const {
+        return HIE_NODE_UP;
+    }
+
 };
 
 /**
@@ -143,6 +487,21 @@ class HIE_DownNode : public HIE_BaseNode {
         return node->GetDown();
     }
 
+    /* Override: HIE_BaseNode */
+    void GetNextNodes(GeListNode* const* input, GeListNode** output,
+                      LONG count) const {
+        LONG index = 0;
+        for (; index < count; index++) {
+            GeListNode* node = input[index];
+            output[index] = node ? node->GetDown() : NULL;
+        }
+    }
+
+    /* Override: HIE_BaseNode */
+    LONG GetType() const {
+        return HIE_NODE_DOWN;
+    }
+
 };
 
 /**
@@ -153,8 +512,14 @@ class HIE_CacheNode : public HIE_BaseNode {
 
 public:
 
-    /* Override: HIE_BaseNode */
-    GeListNode* GetNextNode(GeListNode* node) const {
+    /**
+     * Retrieves the cache of a node. Shared with other evaluators of
+     * the `C` instruction.
+     * @param node The node to retrieve the cache of. Assumed to be
+     * not NULL.
+     * @return The deform cache or cache of the node. May be NULL.
+     */
+    static GeListNode* GetCache(GeListNode* node) {
         if (!node->IsInstanceOf(Obase)) return NULL;
         BaseObject* op = (BaseObject*) node;
         BaseObject* cache = op->GetDeformCache();
@@ -162,53 +527,436 @@ public:
         return cache;
     }
 
-};
-
-/**
- * This node implements the OR operator for instructions.
- */
-class HIE_OrOperatorNode : public HIE_BaseNode {
+    /* Override: HIE_BaseNode */
+    GeListNode* GetNextNode(GeListNode* node) const {
+        return GetCache(node);
+    }
+
+    /* Override: HIE_BaseNode */
+    void GetNextNodes(GeListNode* const* input, GeListNode** output,
+                      LONG count) const {
+        LONG index = 0;
+        for (; index < count; index++) {
+            GeListNode* node = input[index];
+            output[index] = node ? GetCache(node) : NULL;
+        }
+    }
+
+    /* Override: HIE_BaseNode */
+    LONG GetType() const {
+        return HIE_NODE_CACHE;
+    }
+
+};
+
+/**
+ * Computes the hash of an object name that is matched by the `[H...]`
+ * filter of an HIE.
+ * @param name The name.
+ * @return The hash.
+ */
+inline ULONG HIE_HashName(const String& name) {
+    ULONG hash = 2166136261u;
+    LONG length = name.GetLength();
+    LONG index = 0;
+    for (; index < length; index++) {
+        hash = (hash ^ (ULONG) name[index]) * 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * This node evaluates the filter instructions of an HIE, e.g.
+ * `[T5100]`. It returns the passed node if it passes the test and
+ * NULL if not, so the nodes following it are never visited for
+ * nodes that do not match.
+ */
+class HIE_FilterNode : public HIE_BaseNode {
+
+    /**
+     * The test, one of the FILTER_* values.
+     */
+    LONG filter;
+
+    /**
+     * The value the node is tested against.
+     */
+    LONG value;
+
+    /**
+     * Whether the result of the test is inverted.
+     */
+    Bool negate;
+
+    public:
+
+    /**
+     * `[T...]`, the node is an instance of the type id.
+     */
+    static const LONG FILTER_TYPE = 0;
+
+    /**
+     * `[G...]`, the node is an object with a tag of the type id.
+     */
+    static const LONG FILTER_TAG = 1;
+
+    /**
+     * `[H...]`, the HIE_HashName() of the node's name equals the
+     * value.
+     */
+    static const LONG FILTER_NAME = 2;
+
+    /**
+     * `[B...]`, all bits of the value are set on the node.
+     */
+    static const LONG FILTER_BIT = 3;
+
+    /**
+     * Initialize the filter.
+     * @param filter The test, one of the FILTER_* values.
+     * @param value The value the node is tested against.
+     * @param negate Whether the result of the test is inverted.
+     */
+    HIE_FilterNode(LONG filter, LONG value, Bool negate)
+    : filter(filter), value(value), negate(negate) {}
+
+    /**
+     * Tests a node. Shared with other evaluators of filters.
+     * @param filter The test, one of the FILTER_* values.
+     * @param value The value the node is tested against.
+     * @param node The node to test. Assumed to be not NULL.
+     * @return TRUE if the node passes the test, FALSE if not.
+     */
+    static Bool Match(LONG filter, LONG value, GeListNode* node) {
+        switch (filter) {
+            case FILTER_TYPE:
+                return node->IsInstanceOf(value);
+            case FILTER_TAG:
+                if (!node->IsInstanceOf(Obase)) return FALSE;
+                return ((BaseObject*) node)->GetTag(value) != NULL;
+            case FILTER_NAME:
+                if (!node->IsInstanceOf(Tbaselist2d)) return FALSE;
+                return HIE_HashName(((BaseList2D*) node)->GetName()) == (ULONG) value;
+            case FILTER_BIT:
+                if (!node->IsInstanceOf(Tbaselist2d)) return FALSE;
+                return (((BaseList2D*) node)->GetAllBits() & value) == value;
+            default:
+                return FALSE;
+        }
+    }
+
+    /* Override: HIE_BaseNode */
+    GeListNode* GetNextNode(GeListNode* node) const {
+        if (!node) return NULL;
+        return Match(filter, value, node) != negate ? node : NULL;
+    }
+
+    /* Override: HIE_BaseNode */
+    LONG GetType() const {
+        return HIE_NODE_FILTER;
+    }
+
+    /**
+     * @return The test, one of the FILTER_* values.
+     */
+    LONG GetFilter() const {
+        return filter;
+    }
+
+    /**
+     * @return The value the node is tested against.
+     */
+    LONG GetValue() const {
+        return value;
+    }
+
+    /**
+     * @return TRUE if the result of the test is inverted.
+     */
+    Bool IsNegated() const {
+        return negate;
+    }
+
+};
+
+/**
+ * This node implements the OR operator for instructions.
+ */
+class HIE_OrOperatorNode : public HIE_BaseNode {
+
+    /**
+     * The left-hand node of the operator. Has precedance over
+     * the right-hand node.
+     */
+    HIE_BaseNode* left;
+
+     /**
+      * The right-hand node of the operator.
+      */
+    HIE_BaseNode* right;
+
+    /**
+     * TRUE when one of the operands is multi-valued.
+     */
+    Bool multi;
+
+public:
+
+    /**
+     * Must be initialized with a left and right-hand node.
+     * @param left The left hand instruction.
+     * @param right The right hand instruction.
+     */
+    HIE_OrOperatorNode(HIE_BaseNode* left, HIE_BaseNode* right)
+    : left(left), right(right) {
+        multi = left->IsMultiValued() || right->IsMultiValued();
+    }
+
+    /**
+     * Destructor.
+     */
+    virtual ~HIE_OrOperatorNode() {
+        if (left) {
+            delete left;
+            left = NULL;
+        }
+        if (right) {
+            delete right;
+            right = NULL;
+        }
+    }
+
+    /* Override: HIE_BaseNode */
+    GeListNode* GetNextNode(GeListNode* node) const {
+        GeListNode* dest = left->GetNextNode(node);
+        if (!dest) dest = right->GetNextNode(node);
+        return dest;
+    }
+
+    /* Override: HIE_BaseNode */
+    void GetNextNodes(GeListNode* const* input, GeListNode** output,
+                      LONG count) const;
+
+    /* Override: HIE_BaseNode */
+    Bool Enumerate(GeListNode* node, HIE_Sink* sink) const;
+
+    /* Override: HIE_BaseNode */
+    Bool IsMultiValued() const {
+        return multi;
+    }
+
+    /* Override: HIE_BaseNode */
+    LONG GetType() const {
+        return HIE_NODE_OR;
+    }
+
+    /**
+     * @return The left-hand node of the operator.
+     */
+    HIE_BaseNode* GetLeft() const {
+        return left;
+    }
+
+    /**
+     * @return The right-hand node of the operator.
+     */
+    HIE_BaseNode* GetRight() const {
+        return right;
+    }
+
+    /**
+     * Replaces the operands of the operator. The previous operands
+     * are not deallocated.
+     * @param left The new left-hand node.
+     * @param right The new right-hand node.
+     */
+    void SetOperands(HIE_BaseNode* left, HIE_BaseNode* right) {
+        this->left = left;
+        this->right = right;
+        multi = (left && left->IsMultiValued()) ||
+                (right && right->IsMultiValued());
+    }
+
+};
+
+/**
+ * This node applies one of the `N`, `P`, `U`, `D` and `C` instructions
+ * a number of times in a row. Created by HIE_Optimize() for runs of
+ * equal instructions, e.g. `NNNN`.
+ */
+class HIE_StepNode : public HIE_BaseNode {
+
+    /**
+     * The instruction, one of HIE_NODE_NEXT, HIE_NODE_PRED,
+     * HIE_NODE_UP, HIE_NODE_DOWN and HIE_NODE_CACHE.
+     */
+    LONG instruction;
+
+    /**
+     * The number of times the instruction is applied.
+     */
+    LONG count;
+
+    public:
+
+    /**
+     * Initialize the node.
+     * @param instruction The node type of the instruction.
+     * @param count The number of times the instruction is applied.
+     */
+    HIE_StepNode(LONG instruction, LONG count)
+    : instruction(instruction), count(count) {}
+
+    /* Override: HIE_BaseNode */
+    GeListNode* GetNextNode(GeListNode* node) const {
+        LONG n = count;
+        switch (instruction) {
+            case HIE_NODE_NEXT:
+                for (; n > 0 && node; n--) node = node->GetNext();
+                break;
+            case HIE_NODE_PRED:
+                for (; n > 0 && node; n--) node = node->GetPred();
+                break;
+            case HIE_NODE_UP:
+                for (; n > 0 && node; n--) node = node->GetUp();
+                break;
+            case HIE_NODE_DOWN:
+                for (; n > 0 && node; n--) node = node->GetDown();
+                break;
+            case HIE_NODE_CACHE:
+                for (; n > 0 && node; n--) node = HIE_CacheNode::GetCache(node);
+                break;
+            default:
+                node = NULL;
+                break;
+        }
+        return node;
+    }
+
+    /* Override: HIE_BaseNode */
+    LONG GetType() const {
+        return HIE_NODE_STEP;
+    }
+
+    /**
+     * @return The node type of the instruction.
+     */
+    LONG GetInstruction() const {
+        return instruction;
+    }
+
+    /**
+     * @return The number of times the instruction is applied.
+     */
+    LONG GetCount() const {
+        return count;
+    }
+
+};
+
+/**
+ * This node implements the `*` and `+` operators, applying a node
+ * repeatedly until it returns NULL. GetNextNode() returns the last
+ * node reached, Enumerate() yields every node on the way.
+ */
+class HIE_RepeatNode : public HIE_BaseNode {
+
+    /**
+     * The node being repeated.
+     */
+    HIE_BaseNode* node;
+
+    /**
+     * The number of times the node must succeed, 0 for `*` and 1
+     * for `+`.
+     */
+    LONG minimum;
+
+    public:
+
+    /**
+     * The maximum number of repetitions. Stops expressions that
+     * cycle, e.g. `(N|P)*`.
+     */
+    static const LONG MAX_ITERATIONS = 0x1000000;
+
+    /**
+     * The maximum nesting of Enumerate() for multi-valued nodes.
+     */
+    static const LONG MAX_DEPTH = 1024;
+
+    /**
+     * Initialize the repetition of a node.
+     * @param node The node to repeat.
+     * @param minimum The number of times the node must succeed for
+     * the repetition to succeed.
+     */
+    HIE_RepeatNode(HIE_BaseNode* node, LONG minimum)
+    : node(node), minimum(minimum) {}
+
+    /**
+     * Destructor.
+     */
+    virtual ~HIE_RepeatNode() {
+        if (node) {
+            delete node;
+            node = NULL;
+        }
+    }
+
+    /* Override: HIE_BaseNode */
+    GeListNode* GetNextNode(GeListNode* start) const {
+        GeListNode* dest = start;
+        LONG count = 0;
+        while (count < MAX_ITERATIONS) {
+            GeListNode* next = node->GetNextNode(dest);
+            if (!next || next == dest) break;
+            dest = next;
+            count++;
+        }
+        return count < minimum ? NULL : dest;
+    }
+
+    /* Override: HIE_BaseNode */
+    Bool Enumerate(GeListNode* start, HIE_Sink* sink) const;
 
     /**
-     * The left-hand node of the operator. Has precedance over
-     * the right-hand node.
+     * Yields the nodes reached by repeating the node from `start`
+     * on, excluding `start`.
      */
-    HIE_BaseNode* left;
+    Bool EnumerateFrom(GeListNode* start, HIE_Sink* sink, LONG depth) const;
 
-     /**
-      * The right-hand node of the operator.
-      */
-    HIE_BaseNode* right;
+    /* Override: HIE_BaseNode */
+    Bool IsMultiValued() const {
+        return TRUE;
+    }
 
-public:
+    /* Override: HIE_BaseNode */
+    LONG GetType() const {
+        return HIE_NODE_REPEAT;
+    }
 
     /**
-     * Must be initialized with a left and right-hand node.
-     * @param left The left hand instruction.
-     * @param right The right hand instruction.
+     * @return The node being repeated.
      */
-    HIE_OrOperatorNode(HIE_BaseNode* left, HIE_BaseNode* right)
-    : left(left), right(right) {}
+    HIE_BaseNode* GetNode() const {
+        return node;
+    }
 
     /**
-     * Destructor.
+     * Replaces the node being repeated. The previous node is not
+     * deallocated.
+     * @param node The new node.
      */
-    virtual ~HIE_OrOperatorNode() {
-        if (left) {
-            delete left;
-            left = NULL;
-        }
-        if (right) {
-            delete right;
-            right = NULL;
-        }
+    void SetNode(HIE_BaseNode* node) {
+        this->node = node;
     }
 
-    /* Override: HIE_BaseNode */
-    GeListNode* GetNextNode(GeListNode* node) const {
-        GeListNode* dest = left->GetNextNode(node);
-        if (!dest) dest = right->GetNextNode(node);
-        return dest;
+    /**
+     * @return The number of times the node must succeed.
+     */
+    LONG GetMinimum() const {
+        return minimum;
     }
 
 };
@@ -222,7 +970,27 @@ class HIE_Container : public HIE_BaseNode {
      * This array contains every node in the container being asked for
      * a next node.
      */
-    GeDynamicArray<HIE_BaseNode*> nodes;
+    HIE_BaseNode** nodes;
+
+    /**
+     * The number of nodes in the container.
+     */
+    LONG count;
+
+    /**
+     * The number of nodes `nodes` can hold.
+     */
+    LONG capacity;
+
+    /**
+     * TRUE when the nodes and the array are owned by a HIE_Arena.
+     */
+    Bool borrowed;
+
+    /**
+     * TRUE when one of the nodes is multi-valued.
+     */
+    Bool multi;
 
     public:
 
@@ -251,21 +1019,29 @@ class HIE_Container : public HIE_BaseNode {
      */
     static const LONG MODE_FIRST = 2;
 
+    /**
+     * Initialize an empty container in consecutive mode.
+     */
+    HIE_Container()
+    : nodes(NULL), count(0), capacity(0), borrowed(FALSE), multi(FALSE),
+      mode(MODE_CONSECUTIVE) {}
+
     /**
      * Destructor.
      */
     virtual ~HIE_Container() {
-        LONG count = nodes.GetCount();
+        if (borrowed) return;
         LONG index = 0;
         for (; index < count; index++) {
             delete nodes[index];
         }
-        nodes.FreeArray();
+        if (nodes) GeFree(nodes);
+        nodes = NULL;
+        count = 0;
     }
 
     /* Override: HIE_BaseNode */
     GeListNode* GetNextNode(GeListNode* node) const {
-        LONG count = nodes.GetCount();
         LONG index = 0;
         GeListNode* dest = NULL;
         switch (mode) {
@@ -286,6 +1062,7 @@ class HIE_Container : public HIE_BaseNode {
                     dest = nodes[index]->GetNextNode(node);
                     if (dest) break;
                 }
+                break;
             default:
                 #ifdef DEBUG
                     GeDebugOut("WARNING: Invalid mode for HIE_Container: "
@@ -296,15 +1073,140 @@ class HIE_Container : public HIE_BaseNode {
         return dest;
     }
 
+    /* Override: HIE_BaseNode */
+    void GetNextNodes(GeListNode* const* input, GeListNode** output,
+                      LONG count) const;
+
+    /* Override: HIE_BaseNode */
+    Bool Enumerate(GeListNode* node, HIE_Sink* sink) const;
+
+    /**
+     * Yields the nodes reached by passing `node` to the nodes of a
+     * consecutive or accumulative container from `index` on.
+     */
+    Bool EnumerateFrom(LONG index, GeListNode* node, HIE_Sink* sink) const;
+
+    /* Override: HIE_BaseNode */
+    Bool IsMultiValued() const {
+        return multi;
+    }
+
     /**
      * Add a node to the end of the container.
      * @param node The node to add.
      */
     void Push(HIE_BaseNode* node) {
-        if (node)
-            nodes.Push(node);
+        if (!node || borrowed) return;
+        if (count == capacity && !Reserve(capacity ? capacity * 2 : 4))
+            return;
+        nodes[count++] = node;
+        if (node->IsMultiValued()) multi = TRUE;
+    }
+
+    /**
+     * Make room for a number of nodes so they can be pushed without
+     * growing the array in between.
+     * @param size The number of nodes the container should hold.
+     * @return TRUE on success, FALSE if not.
+     */
+    Bool Reserve(LONG size) {
+        if (borrowed) return FALSE;
+        if (size <= capacity) return TRUE;
+        HIE_BaseNode** array = (HIE_BaseNode**) GeAlloc(sizeof(HIE_BaseNode*) * size);
+        if (!array) return FALSE;
+        if (count) memcpy(array, nodes, sizeof(HIE_BaseNode*) * count);
+        if (nodes) GeFree(nodes);
+        nodes = array;
+        capacity = size;
+        return TRUE;
+    }
+
+    /**
+     * Make the container use an array of nodes that was allocated in
+     * the same HIE_Arena as the container and its nodes. The container
+     * does not free the array or the nodes. Must be called on an empty
+     * container.
+     * @param array The nodes.
+     * @param size The number of nodes in the array.
+     */
+    void Borrow(HIE_BaseNode** array, LONG size) {
+        nodes = array;
+        count = size;
+        capacity = size;
+        borrowed = TRUE;
+
+        LONG index = 0;
+        for (; index < size; index++) {
+            if (array[index]->IsMultiValued()) multi = TRUE;
+        }
+    }
+
+    /**
+     * Replaces the nodes of the container. The previous nodes are not
+     * deallocated. A container borrowing its array from a HIE_Arena
+     * reuses the array if it is large enough and allocates a new one
+     * from the arena otherwise.
+     * @param array The new nodes. May be NULL if `size` is 0.
+     * @param size The number of new nodes.
+     * @param arena The arena the container lives in, or NULL.
+     * @return TRUE on success, FALSE if memory could not be allocated.
+     * The container is unchanged in that case.
+     */
+    Bool Replace(HIE_BaseNode* const* array, LONG size, HIE_Arena* arena) {
+        if (size > capacity) {
+            if (borrowed) {
+                if (!arena) return FALSE;
+                HIE_BaseNode** memory = (HIE_BaseNode**) arena->Alloc(sizeof(HIE_BaseNode*) * size);
+                if (!memory) return FALSE;
+                nodes = memory;
+                capacity = size;
+            }
+            else {
+                HIE_BaseNode** memory = (HIE_BaseNode**) GeAlloc(sizeof(HIE_BaseNode*) * size);
+                if (!memory) return FALSE;
+                if (nodes) GeFree(nodes);
+                nodes = memory;
+                capacity = size;
+            }
+        }
+
+        if (size > 0) memmove(nodes, array, sizeof(HIE_BaseNode*) * size);
+        count = size;
+
+        multi = FALSE;
+        LONG index = 0;
+        for (; index < size; index++) {
+            if (nodes[index]->IsMultiValued()) multi = TRUE;
+        }
+        return TRUE;
+    }
+
+    /* Override: HIE_BaseNode */
+    LONG GetType() const {
+        return HIE_NODE_CONTAINER;
+    }
+
+    /**
+     * @return The number of nodes in the container.
+     */
+    LONG GetCount() const {
+        return count;
+    }
+
+    /**
+     * @param index The index of the node, must be in range.
+     * @return The node at the passed index.
+     */
+    HIE_BaseNode* GetNode(LONG index) const {
+        return nodes[index];
     }
 
+    /**
+     * @return The array of nodes in the container.
+     */
+    HIE_BaseNode* const* GetNodes() const {
+        return nodes;
+    }
 
 };
 
@@ -315,17 +1217,27 @@ class HIE_Container : public HIE_BaseNode {
 class HIE_InputScanner {
 
     /**
-     * The input string.
+     * The input string, UTF-8 encoded.
      */
-    char* input;
+    const char* input;
 
     /**
-     * The length of the input string.
+     * The length of the input string in bytes.
      */
     int inputLength;
 
     /**
-     * The position in the input string.
+     * Whether `input` was allocated by the scanner.
+     */
+    Bool owned;
+
+    /**
+     * The byte offset of the current character in the input string.
+     */
+    int offset;
+
+    /**
+     * The position in the input string, counted in characters.
      */
     int position;
 
@@ -333,38 +1245,38 @@ class HIE_InputScanner {
 
     /**
      * Initialize the HIE_InputScanner from a Cinema 4D String
-     * object.
+     * object. The string is converted to UTF-8.
      * @param string The string to initiaize the scanner with.
      */
-    HIE_InputScanner(String string) : position(-1) {
-        inputLength = string.GetLength();
-        input = string.GetCStringCopy();
+    HIE_InputScanner(const String& string) : owned(TRUE), offset(-1), position(-1) {
+        input = string.GetCStringCopy(STRINGENCODING_UTF8);
+        inputLength = input ? (int) strlen(input) : 0;
     }
 
     /**
      * Initialize the HIE_InputScanner from a native C-style
-     * string.
-     * @param string The C-style character array.
-     * @param length The length of the input string. Pass a negative
-     * number for automatic detection.
+     * string. The string is not copied and must stay valid while
+     * the scanner is in use, e.g. a memory-mapped file or an entry
+     * of a string table.
+     * @param string The UTF-8 encoded character array.
+     * @param length The length of the input string in bytes. Pass a
+     * negative number for automatic detection.
      */
-    HIE_InputScanner(char* string, int length=-1) : position(-1) {
+    HIE_InputScanner(const char* string, int length=-1)
+    : input(string), owned(FALSE), offset(-1), position(-1) {
         if (length < 0)
-            length = strlen(string);
+            length = string ? (int) strlen(string) : 0;
         inputLength = length;
-        input = (char*) GeAlloc(inputLength + 1);
-        memcpy(input, string, inputLength);
-        input[inputLength] = 0;
     }
 
     /**
      * Destructor.
      */
     ~HIE_InputScanner() {
-        if (input) {
-            GeFree(input);
-            input = NULL;
+        if (input && owned) {
+            GeFree((void*) input);
         }
+        input = NULL;
     }
 
     /**
@@ -378,13 +1290,20 @@ class HIE_InputScanner {
                            "string.");
             }
         #endif
-        return input[position];
+        return input[offset];
     }
 
     /**
-     * Jump to the next character in the input string.
+     * Jump to the next character in the input string. A multi-byte
+     * UTF-8 character is skipped as a whole, Chr() returns its first
+     * byte which never matches an instruction.
      */
     void Read() {
+        offset++;
+        if (offset > 0) {
+            while (offset < inputLength && (input[offset] & 0xC0) == 0x80)
+                offset++;
+        }
         position++;
     }
 
@@ -393,7 +1312,7 @@ class HIE_InputScanner {
      * input) FALSE if there are character left to read.
      */
     Bool End() const {
-        return position >= inputLength;
+        return offset >= inputLength;
     }
 
     /**
@@ -401,18 +1320,20 @@ class HIE_InputScanner {
      * yet, FALSE if not.
      */
     Bool Begin() const {
-        return position == -1;
+        return offset == -1;
     }
 
     /**
-     * @return The position in the input string.
+     * @return The position in the input string, counted in
+     * characters.
      */
     int GetPosition() const {
         return position;
     }
 
     /**
-     * @return The length of the input string.
+     * @return The length of the input string in bytes. This is an
+     * upper bound for the number of characters.
      */
     int GetLength() const {
         return inputLength;
@@ -627,11 +1548,68 @@ class HIE_CompilerOptions {
      */
     char instr_Gaccum;
 
+    /**
+     * The postfix operator repeating an instruction zero or more
+     * times.
+     */
+    char instr_Star;
+
+    /**
+     * The postfix operator repeating an instruction one or more
+     * times.
+     */
+    char instr_Plus;
+
+    /**
+     * Opens a filter, e.g. `[T5100]`.
+     */
+    char instr_Fopen;
+
+    /**
+     * Closes a filter.
+     */
+    char instr_Fclose;
+
+    /**
+     * Inverts a filter when it follows instr_Fopen, e.g. `[!T5100]`.
+     */
+    char instr_Fnot;
+
+    /**
+     * Filters by type id, see HIE_FilterNode::FILTER_TYPE.
+     */
+    char instr_Ftype;
+
+    /**
+     * Filters by tag type id, see HIE_FilterNode::FILTER_TAG.
+     */
+    char instr_Ftag;
+
+    /**
+     * Filters by name hash, see HIE_FilterNode::FILTER_NAME.
+     */
+    char instr_Fname;
+
+    /**
+     * Filters by bits, see HIE_FilterNode::FILTER_BIT.
+     */
+    char instr_Fbit;
+
+    /**
+     * Whether filters are supported or not.
+     */
+    Bool instr_F_supported;
+
     /**
      * The compilation mode.
      */
     LONG mode;
 
+    /**
+     * Whether the compiled tree is passed to HIE_Optimize().
+     */
+    Bool optimize;
+
     /**
      * Initializes the HIE_CompilerOptions object with the default
      * values.
@@ -649,11 +1627,77 @@ class HIE_CompilerOptions {
         instr_Gconsecutive = '!';
         instr_Gfirst = '?';
         instr_Gaccum = '~';
+        instr_Star = '*';
+        instr_Plus = '+';
+        instr_Fopen = '[';
+        instr_Fclose = ']';
+        instr_Fnot = '!';
+        instr_Ftype = 'T';
+        instr_Ftag = 'G';
+        instr_Fname = 'H';
+        instr_Fbit = 'B';
+        instr_F_supported = TRUE;
         mode = MODE_STRICT;
+        optimize = FALSE;
+    }
+
+    /**
+     * @return TRUE when both options compile every expression to
+     * the same result, FALSE if not.
+     */
+    Bool IsEqual(const HIE_CompilerOptions& other) const {
+        return instr_N == other.instr_N &&
+               instr_P == other.instr_P &&
+               instr_D == other.instr_D &&
+               instr_U == other.instr_U &&
+               instr_C == other.instr_C &&
+               instr_C_supported == other.instr_C_supported &&
+               instr_Gopen == other.instr_Gopen &&
+               instr_Gclose == other.instr_Gclose &&
+               instr_Or == other.instr_Or &&
+               instr_Gconsecutive == other.instr_Gconsecutive &&
+               instr_Gfirst == other.instr_Gfirst &&
+               instr_Gaccum == other.instr_Gaccum &&
+               instr_Star == other.instr_Star &&
+               instr_Plus == other.instr_Plus &&
+               instr_Fopen == other.instr_Fopen &&
+               instr_Fclose == other.instr_Fclose &&
+               instr_Fnot == other.instr_Fnot &&
+               instr_Ftype == other.instr_Ftype &&
+               instr_Ftag == other.instr_Ftag &&
+               instr_Fname == other.instr_Fname &&
+               instr_Fbit == other.instr_Fbit &&
+               instr_F_supported == other.instr_F_supported &&
+               mode == other.mode &&
+               optimize == other.optimize;
+    }
+
+    /**
+     * @return A hash of the options. Equal options have an equal
+     * fingerprint.
+     */
+    ULONG GetFingerprint() const {
+        LONG values[] = {
+            instr_N, instr_P, instr_D, instr_U, instr_C,
+            instr_C_supported ? 1 : 0, instr_Gopen, instr_Gclose, instr_Or,
+            instr_Gconsecutive, instr_Gfirst, instr_Gaccum, instr_Star,
+            instr_Plus, instr_Fopen, instr_Fclose, instr_Fnot, instr_Ftype,
+            instr_Ftag, instr_Fname, instr_Fbit, instr_F_supported ? 1 : 0,
+            mode, optimize ? 1 : 0,
+        };
+        ULONG hash = 2166136261u;
+        LONG index = 0;
+        for (; index < (LONG) (sizeof(values) / sizeof(values[0])); index++) {
+            hash = (hash ^ (ULONG) values[index]) * 16777619u;
+        }
+        return hash;
     }
 
 };
 
+class HIE_Expression;
+class HIE_CompileContext;
+
 /**
  * This class parses an HIE input expression and builds a node
  * structure for evaluating it.
@@ -692,14 +1736,222 @@ class HIE_Compiler {
      * @return A pointer to a HIE_Container node, or NULL if the
      * compilation failed.
      */
-    HIE_Container* Compile(String input, HIE_ErrorLog* log) const;
+    HIE_Container* Compile(const String& input, HIE_ErrorLog* log) const;
+
+    /**
+     * Parse an input expression into a HIE_Expression. All nodes and
+     * node arrays of the expression are placed in a single HIE_Arena
+     * block owned by the expression.
+     * @param string The input string with the HIE expression.
+     * @param log Instance for logging errors.
+     * @return A new expression with a single reference, or NULL if the
+     * compilation failed.
+     */
+    HIE_Expression* CompileExpression(const String& input, HIE_ErrorLog* log) const;
+
+    /**
+     * Parse an input expression from a character buffer without
+     * copying it, e.g. from a memory-mapped file.
+     * @param input The UTF-8 encoded input expression. Need not be
+     * null-terminated when `length` is passed.
+     * @param length The length of the input in bytes, or a negative
+     * number if the input is null-terminated.
+     * @param log Instance for logging errors.
+     * @return A pointer to a HIE_Container node, or NULL if the
+     * compilation failed.
+     */
+    HIE_Container* Compile(const char* input, LONG length, HIE_ErrorLog* log) const;
+
+    /**
+     * Parse an input expression from a character buffer without
+     * copying it into an arena-backed HIE_Expression.
+     * @param input The UTF-8 encoded input expression.
+     * @param length The length of the input in bytes, or a negative
+     * number if the input is null-terminated.
+     * @param log Instance for logging errors.
+     * @return A new expression with a single reference, or NULL if the
+     * compilation failed.
+     */
+    HIE_Expression* CompileExpression(const char* input, LONG length,
+                                      HIE_ErrorLog* log) const;
+
+    /**
+     * Parse an input expression into nodes allocated from a HIE_Arena
+     * of the caller. The nodes are never destructed, the result is
+     * released by freeing the arena. Fails if the arena is exhausted,
+     * GetArenaSize() bytes are always enough.
+     * @param input The UTF-8 encoded input expression.
+     * @param length The length of the input in bytes, or a negative
+     * number if the input is null-terminated.
+     * @param log Instance for logging errors.
+     * @param arena The arena to allocate the nodes from.
+     * @return A pointer to a HIE_Container node in the arena, or NULL
+     * if the compilation failed.
+     */
+    HIE_Container* Compile(const char* input, LONG length, HIE_ErrorLog* log,
+                           HIE_Arena* arena) const;
+
+    /**
+     * @param length The length of an input expression in bytes.
+     * @return The number of bytes of a HIE_Arena that is guaranteed to
+     * hold the compiled expression, or -1 if that does not fit into a
+     * LONG.
+     */
+    static LONG GetArenaSize(LONG length);
 
     private:
 
     /**
-     * Reads in a node at the current place.
+     * Parses the input of the scanner into a HIE_Container.
+     */
+    HIE_Container* Compile(HIE_InputScanner& scanner, HIE_ErrorLog* log,
+                           HIE_CompileContext& context) const;
+
+    /**
+     * Reads a filter, the scanner is positioned at instr_Fopen.
+     */
+    HIE_BaseNode* ReadFilter(HIE_InputScanner& scanner, HIE_ErrorLog* log,
+                             HIE_CompileContext& context) const;
+
+    /**
+     * Parses the input of the scanner into an arena-backed
+     * HIE_Expression.
+     */
+    HIE_Expression* CompileExpression(HIE_InputScanner& scanner,
+                                      HIE_ErrorLog* log) const;
+
+    /**
+     * Reads in a node at the current place. Nested groups and
+     * operators are tracked on an explicit stack, so the call stack
+     * does not grow with the nesting of the input.
+     */
+    HIE_BaseNode* ReadNode(HIE_InputScanner& scanner, HIE_ErrorLog* log,
+                           HIE_CompileContext& context) const;
+
+};
+
+/**
+ * A compiled expression that is shared by reference counting, e.g.
+ * by the HIE_ExpressionCache. The expression is never modified after
+ * it was created and may be evaluated from multiple threads.
+ */
+class HIE_Expression {
+
+    /**
+     * The root of the compiled node tree. Owned by the expression.
+     */
+    HIE_Container* root;
+
+    /**
+     * The number of references to the expression.
+     */
+    LONG refs;
+
+    /**
+     * Guards `refs`.
+     */
+    GeSpinlock lock;
+
+    /**
+     * The arena holding the nodes of the expression. Not initialized
+     * when the nodes were allocated individually.
+     */
+    HIE_Arena arena;
+
+    /**
+     * Destructor. Use Release() instead.
+     */
+    ~HIE_Expression() {
+        // Nodes in an arena are freed with it and are not deleted.
+        if (root && !arena.IsInit()) {
+            delete root;
+        }
+        root = NULL;
+        arena.Free();
+    }
+
+    public:
+
+    /**
+     * Initialize the expression with a single reference.
+     * @param root The root of the compiled node tree. The expression
+     * takes ownership of it.
+     */
+    HIE_Expression(HIE_Container* root) : root(root), refs(1) {}
+
+    /**
+     * Initialize the expression with a single reference from a node
+     * tree placed in an arena.
+     * @param root The root of the compiled node tree.
+     * @param arena The arena holding the node tree. The expression
+     * takes over its block.
+     */
+    HIE_Expression(HIE_Container* root, HIE_Arena& arena)
+    : root(root), refs(1) {
+        this->arena.Take(arena);
+    }
+
+    /**
+     * @return The root of the compiled node tree.
+     */
+    const HIE_Container* GetRoot() const {
+        return root;
+    }
+
+    /**
+     * Evaluates the expression.
+     * @param node The start node. Assumed to be not NULL.
+     * @return The resulting node. May be NULL.
+     */
+    GeListNode* GetNextNode(GeListNode* node) const {
+        return root->GetNextNode(node);
+    }
+
+    /**
+     * Yields every node the expression reaches.
+     * @param node The start node. Assumed to be not NULL.
+     * @param sink Receives the nodes.
+     * @return FALSE when the sink stopped the enumeration.
+     */
+    Bool Enumerate(GeListNode* node, HIE_Sink* sink) const {
+        return root->Enumerate(node, sink);
+    }
+
+    /**
+     * Adds a reference to the expression.
+     */
+    void AddRef() {
+        lock.Lock();
+        refs++;
+        lock.Unlock();
+    }
+
+    /**
+     * Removes a reference from the expression and deallocates it when
+     * it was the last one.
+     */
+    void Release() {
+        lock.Lock();
+        LONG left = --refs;
+        lock.Unlock();
+        if (left == 0) delete this;
+    }
+
+    /**
+     * Allocator for a new instance. Overwritten for memory-management
+     * purpose.
+     */
+    void* operator new (size_t size) {
+        return GeAlloc(size);
+    }
+
+    /**
+     * Deallocator for class instances. Overwritten for
+     * memory-management purpose.
      */
-    HIE_BaseNode* ReadNode(HIE_InputScanner& scanner, HIE_ErrorLog* log) const;
+    void operator delete (void* p) {
+        GeFree(p);
+    }
 
 };
 
@@ -718,7 +1970,7 @@ enum {
  * @param error Assigned the HIE_Error object when occured.
  * @return A pointer to a container node. NULL on failure.
  */
-HIE_Container* HIE_CompileExpression(String input, HIE_Error* error,
+HIE_Container* HIE_CompileExpression(const String& input, HIE_Error* error,
             HIE_CompilerOptions* options=NULL);
 
 #endif /* HIE_H */
@@ -0,0 +1,255 @@
+/**
+ * Simplified BSD License
+ * Copyright (C) 2013, Niklas Rosenstein. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * official policies, either expressed or implied, of the copyright
+ * holders.
+ *
+ * ***********************************************************************
+ *
+ * This header defines a set of HIEs that are compiled together, e.g.
+ * all expressions of a configuration file at plugin load. The entries
+ * are compiled on multiple threads into a single memory block.
+ */
+
+#ifndef HIE_BULK_H
+#define HIE_BULK_H
+
+#include "HIE.h"
+
+/**
+ * An entry of a HIE_ExpressionSet.
+ */
+struct HIE_SetEntry {
+
+    /**
+     * The input of the entry while it is compiled, NULL afterwards.
+     */
+    const char* text;
+
+    /**
+     * The length of `text` in bytes.
+     */
+    LONG length;
+
+    /**
+     * The line of the entry in the source text, starting at 1, or
+     * the index of the string for string lists.
+     */
+    LONG line;
+
+    /**
+     * The offset of the entry's part of the memory block.
+     */
+    LONG offset;
+
+    /**
+     * The size of the entry's part of the memory block.
+     */
+    LONG size;
+
+    /**
+     * The compiled expression, NULL if the compilation failed.
+     */
+    HIE_Container* root;
+
+    /**
+     * The last error reported for the entry.
+     */
+    HIE_Error error;
+
+    /**
+     * Whether `error` is set.
+     */
+    Bool hasError;
+
+};
+
+/**
+ * A list of HIEs compiled together. Every entry is compiled into its
+ * own slice of a single memory block, so the threads never share an
+ * allocator and the whole set is released at once. An entry that
+ * fails to compile records its error and does not affect the other
+ * entries.
+ *
+ * The compiled expressions are never modified and may be evaluated
+ * from multiple threads.
+ */
+class HIE_ExpressionSet {
+
+    /**
+     * The memory block of all compiled expressions.
+     */
+    HIE_Arena arena;
+
+    /**
+     * The entries.
+     */
+    HIE_SetEntry* entries;
+
+    /**
+     * The number of entries.
+     */
+    LONG count;
+
+    /**
+     * The number of entries with an error.
+     */
+    LONG errors;
+
+    public:
+
+    /**
+     * The number of entries a thread compiles at once.
+     */
+    static const LONG CHUNK = 64;
+
+    /**
+     * Initialize an empty set.
+     */
+    HIE_ExpressionSet() : entries(NULL), count(0), errors(0) {}
+
+    /**
+     * Destructor.
+     */
+    ~HIE_ExpressionSet() {
+        Free();
+    }
+
+    /**
+     * Compile every line of a text. Leading and trailing whitespace is
+     * ignored, as are empty lines and lines starting with `#`. The
+     * text is not copied and only needs to stay valid during the call.
+     * @param text The UTF-8 encoded text.
+     * @param length The length of the text in bytes, or a negative
+     * number if the text is null-terminated.
+     * @param options The compiler options, NULL for the defaults.
+     * @param threads The number of threads, 0 for the default.
+     * @param parent The parent thread, used for break checks. May be
+     * NULL.
+     * @return TRUE on success, FALSE if memory could not be allocated
+     * or the parent thread requested a break. Entries that do not
+     * compile do not make the call fail, see GetError().
+     */
+    Bool CompileText(const char* text, LONG length,
+                     const HIE_CompilerOptions* options=NULL,
+                     LONG threads=0, BaseThread* parent=NULL);
+
+    /**
+     * Compile a list of strings, one entry per string.
+     * @param strings The strings.
+     * @param count The number of strings.
+     * @see CompileText()
+     */
+    Bool CompileStrings(const String* strings, LONG count,
+                        const HIE_CompilerOptions* options=NULL,
+                        LONG threads=0, BaseThread* parent=NULL);
+
+    /**
+     * Compile every line of a UTF-8 encoded text file.
+     * @param filename The file to read.
+     * @return FALSE also if the file could not be read.
+     * @see CompileText()
+     */
+    Bool CompileFile(const Filename& filename,
+                     const HIE_CompilerOptions* options=NULL,
+                     LONG threads=0, BaseThread* parent=NULL);
+
+    /**
+     * Release all entries. Invalidates the compiled expressions.
+     */
+    void Free();
+
+    /**
+     * @return The number of entries.
+     */
+    LONG GetCount() const {
+        return count;
+    }
+
+    /**
+     * @return The number of entries with an error.
+     */
+    LONG GetErrorCount() const {
+        return errors;
+    }
+
+    /**
+     * @param index The index of the entry.
+     * @return The compiled expression, NULL if the entry failed to
+     * compile. Owned by the set.
+     */
+    HIE_Container* GetExpression(LONG index) const {
+        return entries[index].root;
+    }
+
+    /**
+     * @param index The index of the entry.
+     * @return The last error of the entry, NULL if there was none.
+     */
+    const HIE_Error* GetError(LONG index) const {
+        return entries[index].hasError ? &entries[index].error : NULL;
+    }
+
+    /**
+     * @param index The index of the entry.
+     * @return The line of the entry in the text, starting at 1, or the
+     * index of the string for CompileStrings().
+     */
+    LONG GetLine(LONG index) const {
+        return entries[index].line;
+    }
+
+    /**
+     * Allocator for a new instance. Overwritten for memory-management
+     * purpose.
+     */
+    void* operator new (size_t size) {
+        return GeAlloc(size);
+    }
+
+    /**
+     * Deallocator for class instances. Overwritten for
+     * memory-management purpose.
+     */
+    void operator delete (void* p) {
+        GeFree(p);
+    }
+
+    private:
+
+    /**
+     * Compile the entries after their input has been set up.
+     */
+    Bool Compile(const String* strings, const HIE_CompilerOptions* options,
+                 LONG threads, BaseThread* parent);
+
+};
+
+#endif /* HIE_BULK_H */
@@ -0,0 +1,185 @@
+/**
+ * Simplified BSD License
+ * Copyright (C) 2013, Niklas Rosenstein. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * official policies, either expressed or implied, of the copyright
+ * holders.
+ *
+ * ***********************************************************************
+ *
+ * This header defines a cache for compiled HIEs. Compiling the same
+ * expression text with the same options again returns the shared
+ * HIE_Expression compiled the first time.
+ */
+
+#ifndef HIE_CACHE_H
+#define HIE_CACHE_H
+
+#include "HIE.h"
+
+/**
+ * An entry of the HIE_ExpressionCache.
+ */
+struct HIE_CacheEntry;
+
+/**
+ * Maps expression text and compiler options to shared compiled
+ * expressions. The number of cached expressions is bounded, the least
+ * recently used expression is dropped from the cache first. Dropping
+ * an expression only releases the reference of the cache, callers that
+ * still hold a reference keep it alive. The cache may be used from
+ * multiple threads.
+ */
+class HIE_ExpressionCache {
+
+    /**
+     * The hash table, `bucketCount` chains of entries.
+     */
+    HIE_CacheEntry** buckets;
+
+    /**
+     * The number of chains in `buckets`. A power of two.
+     */
+    LONG bucketCount;
+
+    /**
+     * The most recently used entry.
+     */
+    HIE_CacheEntry* head;
+
+    /**
+     * The least recently used entry.
+     */
+    HIE_CacheEntry* tail;
+
+    /**
+     * The number of entries in the cache.
+     */
+    LONG count;
+
+    /**
+     * The maximum number of entries in the cache.
+     */
+    LONG capacity;
+
+    /**
+     * The number of lookups that found a cached expression.
+     */
+    LONG hits;
+
+    /**
+     * The number of lookups that had to compile the expression.
+     */
+    LONG misses;
+
+    /**
+     * Guards all members.
+     */
+    GeSpinlock lock;
+
+    public:
+
+    /**
+     * The default maximum number of cached expressions.
+     */
+    static const LONG DEFAULT_CAPACITY = 64;
+
+    /**
+     * Initialize an empty cache.
+     * @param capacity The maximum number of cached expressions.
+     */
+    HIE_ExpressionCache(LONG capacity=DEFAULT_CAPACITY);
+
+    /**
+     * Destructor. Releases all cached expressions.
+     */
+    ~HIE_ExpressionCache();
+
+    /**
+     * Returns the compiled expression for the passed input, compiling
+     * it when it is not cached yet. Failed compilations are not
+     * cached.
+     * @param input The input expression.
+     * @param error Assigned the HIE_Error object when occured.
+     * @param options The options for the compiler, or NULL for the
+     * default options.
+     * @return A new reference to the expression which must be freed
+     * with HIE_Expression::Release(), or NULL on failure.
+     */
+    HIE_Expression* Get(const String& input, HIE_Error* error,
+                        const HIE_CompilerOptions* options=NULL);
+
+    /**
+     * Releases all cached expressions.
+     */
+    void Flush();
+
+    /**
+     * @return The number of cached expressions.
+     */
+    LONG GetCount() const {
+        return count;
+    }
+
+    /**
+     * @return The number of lookups that found a cached expression.
+     */
+    LONG GetHits() const {
+        return hits;
+    }
+
+    /**
+     * @return The number of lookups that compiled the expression.
+     */
+    LONG GetMisses() const {
+        return misses;
+    }
+
+    private:
+
+    /**
+     * Returns the entry for the passed key or NULL.
+     */
+    HIE_CacheEntry* Find(const char* text, LONG length, ULONG hash,
+                         const HIE_CompilerOptions& options) const;
+
+    /**
+     * Removes an entry from the hash table and the LRU list and
+     * deallocates it.
+     */
+    void Remove(HIE_CacheEntry* entry);
+
+    /**
+     * Makes an entry the most recently used one.
+     */
+    void Touch(HIE_CacheEntry* entry);
+
+};
+
+#endif /* HIE_CACHE_H */
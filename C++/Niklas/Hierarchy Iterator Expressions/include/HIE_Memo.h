@@ -0,0 +1,240 @@
+/**
+ * Simplified BSD License
+ * Copyright (C) 2013, Niklas Rosenstein. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * official policies, either expressed or implied, of the copyright
+ * holders.
+ *
+ * ***********************************************************************
+ *
+ * This header defines a memoizing evaluator for compiled HIEs. The
+ * result for each start node is remembered until the hierarchy
+ * changes, so evaluating an expression again on an unchanged document
+ * skips the traversal.
+ */
+
+#ifndef HIE_MEMO_H
+#define HIE_MEMO_H
+
+#include "HIE.h"
+
+/**
+ * Computes a stamp that changes whenever the object hierarchy, the
+ * objects or their tags change, suitable for HIE_MemoCache. Tags are
+ * included for the `[G...]` filter. Selection changes and renames do
+ * not reliably change the stamp, which is why HIE_MemoCache does not
+ * memoize expressions with `[B...]` or `[H...]` filters.
+ * @param doc The document. Assumed to be not NULL.
+ * @return The stamp.
+ */
+inline ULONG HIE_GetHierarchyStamp(BaseDocument* doc) {
+    return doc->GetHDirty(HDIRTYFLAGS_OBJECT | HDIRTYFLAGS_OBJECT_HIERARCHY |
+                         HDIRTYFLAGS_TAG);
+}
+
+/**
+ * Remembers the results of a compiled expression per start node. The
+ * caller passes a stamp with every evaluation, e.g. from
+ * HIE_GetHierarchyStamp(). All results are dropped when the stamp
+ * differs from the one of the previous evaluation.
+ *
+ * Expressions that step into generator caches or use `[B...]` or
+ * `[H...]` filters are never memoized, since generator caches, bits
+ * and names may change without changing the stamp. Neither are
+ * expressions with nodes of other types than the ones the compiler
+ * creates, e.g. from HIE_Static.h. They are evaluated on every call
+ * and counted as misses. Call Invalidate() after other changes the
+ * stamp does not cover.
+ *
+ * Unlike the expression, a HIE_MemoCache is modified by evaluation
+ * and must not be used from multiple threads at once.
+ */
+class HIE_MemoCache {
+
+    /**
+     * A start node and its result.
+     */
+    struct Slot {
+        GeListNode* key;
+        GeListNode* value;
+    };
+
+    /**
+     * The expression. Not owned by the cache.
+     */
+    const HIE_BaseNode* root;
+
+    /**
+     * The hash table, open addressing with linear probing.
+     */
+    Slot* slots;
+
+    /**
+     * The number of slots. A power of two.
+     */
+    LONG size;
+
+    /**
+     * The number of used slots.
+     */
+    LONG count;
+
+    /**
+     * The stamp the results belong to.
+     */
+    ULONG stamp;
+
+    /**
+     * The number of evaluations answered from the cache.
+     */
+    LONG hits;
+
+    /**
+     * The number of evaluations that traversed the hierarchy.
+     */
+    LONG misses;
+
+    /**
+     * The number of times the results were dropped.
+     */
+    LONG invalidations;
+
+    /**
+     * FALSE if the results of the expression must not be remembered.
+     */
+    Bool memoize;
+
+    public:
+
+    /**
+     * The initial number of slots.
+     */
+    static const LONG INITIAL_SIZE = 64;
+
+    /**
+     * Initialize an empty cache.
+     * @param root The expression to evaluate. Must outlive the cache.
+     */
+    HIE_MemoCache(const HIE_BaseNode* root);
+
+    /**
+     * Destructor.
+     */
+    ~HIE_MemoCache();
+
+    /**
+     * Evaluates the expression or returns the remembered result.
+     * @param node The start node. Assumed to be not NULL.
+     * @param stamp The current hierarchy stamp.
+     * @return The resulting node. May be NULL.
+     */
+    GeListNode* GetNextNode(GeListNode* node, ULONG stamp);
+
+    /**
+     * Evaluates the expression for a batch of start nodes. Only the
+     * start nodes without a remembered result are evaluated, as one
+     * batch.
+     * @param input The nodes to start from. NULL entries yield NULL.
+     * @param output Receives the resulting nodes. May be equal to
+     * `input`.
+     * @param count The number of nodes in the batch.
+     * @param stamp The current hierarchy stamp.
+     */
+    void GetNextNodes(GeListNode* const* input, GeListNode** output,
+                      LONG count, ULONG stamp);
+
+    /**
+     * Drops all remembered results.
+     */
+    void Invalidate();
+
+    /**
+     * @return TRUE if results of the expression are remembered, FALSE
+     * if it is evaluated on every call.
+     */
+    Bool IsMemoized() const {
+        return memoize;
+    }
+
+    /**
+     * @return The number of evaluations answered from the cache.
+     */
+    LONG GetHits() const {
+        return hits;
+    }
+
+    /**
+     * @return The number of evaluations that traversed the hierarchy.
+     */
+    LONG GetMisses() const {
+        return misses;
+    }
+
+    /**
+     * @return The number of times the results were dropped.
+     */
+    LONG GetInvalidations() const {
+        return invalidations;
+    }
+
+    /**
+     * Resets the hit, miss and invalidation counters.
+     */
+    void ResetCounters() {
+        hits = 0;
+        misses = 0;
+        invalidations = 0;
+    }
+
+    private:
+
+    /**
+     * Drops the results if the stamp changed.
+     */
+    void Validate(ULONG stamp);
+
+    /**
+     * @return The slot of the key, or the empty slot it belongs in.
+     */
+    Slot* Find(GeListNode* key) const;
+
+    /**
+     * Remembers a result.
+     */
+    void Insert(GeListNode* key, GeListNode* value);
+
+    /**
+     * Doubles the number of slots.
+     * @return TRUE on success, FALSE if not.
+     */
+    Bool Grow();
+
+};
+
+#endif /* HIE_MEMO_H */
@@ -0,0 +1,136 @@
+/**
+ * Simplified BSD License
+ * Copyright (C) 2013, Niklas Rosenstein. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * official policies, either expressed or implied, of the copyright
+ * holders.
+ *
+ * ***********************************************************************
+ *
+ * This header defines an optimization pass for compiled HIEs. It
+ * rewrites a node tree into an equivalent one that is cheaper to
+ * evaluate.
+ */
+
+#ifndef HIE_OPTIMIZER_H
+#define HIE_OPTIMIZER_H
+
+#include "HIE.h"
+
+/**
+ * Statistics collected by HIE_Optimize().
+ */
+struct HIE_OptimizerStats {
+
+    /**
+     * The number of nodes before the optimization.
+     */
+    LONG before;
+
+    /**
+     * The number of nodes after the optimization.
+     */
+    LONG after;
+
+    /**
+     * The number of groups that were flattened into their parent or
+     * replaced by their only node.
+     */
+    LONG flattened;
+
+    /**
+     * The number of instructions merged into counted steps.
+     */
+    LONG collapsed;
+
+    /**
+     * The number of alternatives removed because they can never be
+     * reached.
+     */
+    LONG removed;
+
+    HIE_OptimizerStats()
+    : before(0), after(0), flattened(0), collapsed(0), removed(0) {}
+
+    /**
+     * Prints the statistics to the debug console.
+     */
+    void Dump() const {
+        GeDebugOut("HIE_Optimize: %d nodes -> %d nodes (%d groups flattened, "
+                   "%d instructions collapsed, %d alternatives removed)",
+                   before, after, flattened, collapsed, removed);
+    }
+
+};
+
+/**
+ * Optimizes a compiled node tree in place:
+ *
+ * - Groups with a single node are replaced by that node, groups
+ *   nested in a group of the same mode are spliced into it and empty
+ *   groups that do not change the node are removed.
+ * - Runs of the same instruction, e.g. `NNNN`, are replaced by a
+ *   single HIE_StepNode.
+ * - Alternatives of `|` and `?` groups that follow an alternative
+ *   which never fails or repeat an earlier alternative are removed.
+ *
+ * The tree evaluates to the same result afterwards, for GetNextNode()
+ * as well as Enumerate(). It must not be evaluated while it is being
+ * optimized.
+ *
+ * @param root The root container returned by the HIE_Compiler. The
+ * container itself is kept.
+ * @param arena The arena the tree was allocated in, or NULL if the
+ * nodes were allocated individually. Nodes removed from an arena are
+ * not released until the arena is freed, new nodes are allocated from
+ * the arena. Rewrites that do not fit into the arena are skipped.
+ * @param stats Receives statistics about the optimization, may be
+ * NULL.
+ */
+void HIE_Optimize(HIE_Container* root, HIE_Arena* arena=NULL,
+            HIE_OptimizerStats* stats=NULL);
+
+/**
+ * @return The number of nodes in a tree, including the passed node.
+ */
+LONG HIE_CountNodes(const HIE_BaseNode* node);
+
+/**
+ * @return TRUE if both trees are built from the same nodes and thus
+ * always evaluate to the same result, FALSE if not.
+ */
+Bool HIE_IsEqualTree(const HIE_BaseNode* a, const HIE_BaseNode* b);
+
+/**
+ * @return TRUE if the node never returns NULL for a node that is
+ * not NULL, FALSE if it may.
+ */
+Bool HIE_NeverFails(const HIE_BaseNode* node);
+
+#endif /* HIE_OPTIMIZER_H */
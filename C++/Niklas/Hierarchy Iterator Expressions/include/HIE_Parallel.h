@@ -0,0 +1,124 @@
+/**
+ * Simplified BSD License
+ * Copyright (C) 2013, Niklas Rosenstein. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * official policies, either expressed or implied, of the copyright
+ * holders.
+ *
+ * ***********************************************************************
+ *
+ * This header defines helpers for evaluating HIEs on multiple threads.
+ * A batch of start nodes is split into chunks that idle threads pick
+ * up one after another, so threads that got short chains simply take
+ * more chunks than threads that got long ones.
+ */
+
+#ifndef HIE_PARALLEL_H
+#define HIE_PARALLEL_H
+
+#include "HIE.h"
+#include "HIE_Program.h"
+
+/**
+ * The maximum number of threads used by HIE_RunParallel().
+ */
+static const LONG HIE_MAX_THREADS = 64;
+
+/**
+ * The default number of entries a thread picks up at once.
+ */
+static const LONG HIE_DEFAULT_CHUNK = 1024;
+
+/**
+ * Base class for work that is distributed by HIE_RunParallel().
+ */
+class HIE_ParallelJob {
+
+    public:
+
+    /**
+     * Destructor.
+     */
+    virtual ~HIE_ParallelJob() {
+    }
+
+    /**
+     * Processes a range of entries. Called from multiple threads at
+     * once with distinct ranges.
+     * @param begin The first entry of the range.
+     * @param end The entry after the last entry of the range.
+     */
+    virtual void Run(LONG begin, LONG end) = 0;
+
+};
+
+/**
+ * Distributes `count` entries in chunks of `chunk` entries over a pool
+ * of threads and waits for them to finish. Falls back to processing
+ * the entries on the calling thread when a single thread is requested
+ * or the pool can not be started.
+ * @param job The job to run.
+ * @param count The number of entries.
+ * @param chunk The number of entries a thread picks up at once.
+ * @param threads The number of threads. Pass 0 for the number of
+ * render threads of the application.
+ * @param parent The parent thread, used for break checks. May be NULL.
+ * @return TRUE when all entries were processed, FALSE when the
+ * parent thread requested a break.
+ */
+Bool HIE_RunParallel(HIE_ParallelJob* job, LONG count,
+            LONG chunk=HIE_DEFAULT_CHUNK, LONG threads=0,
+            BaseThread* parent=NULL);
+
+/**
+ * Evaluates a compiled HIE for a batch of start nodes on multiple
+ * threads. A compiled node tree is never modified by evaluation, so it
+ * may be shared by all threads. The hierarchy must not change while
+ * the evaluation is running.
+ * @param root The compiled expression.
+ * @param input The nodes to start from. NULL entries yield NULL.
+ * @param output Receives the resulting nodes. May be equal to `input`.
+ * @param count The number of nodes in the batch.
+ * @param threads The number of threads, 0 for the default.
+ * @param parent The parent thread, used for break checks. May be NULL.
+ * @return TRUE when all entries were evaluated.
+ */
+Bool HIE_GetNextNodesParallel(const HIE_BaseNode* root,
+            GeListNode* const* input, GeListNode** output, LONG count,
+            LONG threads=0, BaseThread* parent=NULL);
+
+/**
+ * Evaluates a HIE_Program for a batch of start nodes on multiple
+ * threads. See the HIE_BaseNode overload.
+ */
+Bool HIE_GetNextNodesParallel(const HIE_Program* program,
+            GeListNode* const* input, GeListNode** output, LONG count,
+            LONG threads=0, BaseThread* parent=NULL);
+
+#endif /* HIE_PARALLEL_H */
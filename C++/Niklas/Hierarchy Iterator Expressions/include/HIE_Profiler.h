@@ -0,0 +1,244 @@
+/**
+ * Simplified BSD License
+ * Copyright (C) 2013, Niklas Rosenstein. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * official policies, either expressed or implied, of the copyright
+ * holders.
+ *
+ * ***********************************************************************
+ *
+ * This header defines an instrumented evaluator for compiled HIEs. It
+ * counts how often every node of an expression is visited, how often
+ * it fails and how much time is spent in it, to find the part of an
+ * expression that walks long chains.
+ */
+
+#ifndef HIE_PROFILER_H
+#define HIE_PROFILER_H
+
+#include "HIE.h"
+
+/**
+ * Evaluates a compiled expression like HIE_BaseNode::GetNextNode()
+ * while recording counters for every node. The counters refer to the
+ * nodes by index, in the order the nodes appear in the expression,
+ * and HIE_BaseNode::GetPosition() maps them back to the expression
+ * string.
+ *
+ * Profiling is opt-in and slower than the regular evaluation. A
+ * HIE_Profiler is modified by evaluation and must not be used from
+ * multiple threads at once. The expression must not be modified or
+ * deleted while the profiler exists.
+ */
+class HIE_Profiler {
+
+    /**
+     * The counters of a node.
+     */
+    struct Counter {
+
+        /**
+         * The node.
+         */
+        const HIE_BaseNode* node;
+
+        /**
+         * The number of nodes in the subtree of the node, including
+         * the node itself.
+         */
+        LONG size;
+
+        /**
+         * The nesting depth of the node.
+         */
+        LONG depth;
+
+        /**
+         * The number of times the node was evaluated.
+         */
+        LONG visits;
+
+        /**
+         * The number of times the node returned NULL.
+         */
+        LONG nulls;
+
+        /**
+         * The time spent in the node and its children, in
+         * milliseconds.
+         */
+        Real time;
+
+    };
+
+    /**
+     * The expression. Not owned by the profiler.
+     */
+    const HIE_BaseNode* root;
+
+    /**
+     * The counters of all nodes, in pre-order.
+     */
+    Counter* counters;
+
+    /**
+     * The number of nodes.
+     */
+    LONG count;
+
+    public:
+
+    /**
+     * Prepare the counters for an expression.
+     * @param root The expression, e.g. a HIE_Container returned by
+     * the HIE_Compiler.
+     */
+    HIE_Profiler(const HIE_BaseNode* root);
+
+    /**
+     * Destructor.
+     */
+    ~HIE_Profiler();
+
+    /**
+     * @return TRUE if the counters could be allocated, FALSE if not.
+     * GetNextNode() evaluates without profiling in that case.
+     */
+    Bool IsInit() const {
+        return counters != NULL;
+    }
+
+    /**
+     * Evaluates the expression and updates the counters.
+     * @param node The start node. May be NULL in which case NULL is
+     * returned and nothing is recorded.
+     * @return The resulting node, equal to the result of
+     * HIE_BaseNode::GetNextNode(). May be NULL.
+     */
+    GeListNode* GetNextNode(GeListNode* node);
+
+    /**
+     * Sets all counters to zero.
+     */
+    void Reset();
+
+    /**
+     * @return The number of nodes in the expression.
+     */
+    LONG GetCount() const {
+        return count;
+    }
+
+    /**
+     * @param index The index of the node, 0 is the root.
+     * @return The node.
+     */
+    const HIE_BaseNode* GetNode(LONG index) const {
+        return counters[index].node;
+    }
+
+    /**
+     * @param index The index of the node.
+     * @return The number of times the node was evaluated.
+     */
+    LONG GetVisits(LONG index) const {
+        return counters[index].visits;
+    }
+
+    /**
+     * @param index The index of the node.
+     * @return The number of times the node returned NULL.
+     */
+    LONG GetNulls(LONG index) const {
+        return counters[index].nulls;
+    }
+
+    /**
+     * @param index The index of the node.
+     * @return The time spent in the node including its children, in
+     * milliseconds.
+     */
+    Real GetTime(LONG index) const {
+        return counters[index].time;
+    }
+
+    /**
+     * Formats the counters of all nodes, one line per node indented by
+     * its nesting, e.g. `  or @3: 1200 visits, 800 null, 0.412 ms`.
+     * @return The report.
+     */
+    String GetReport() const;
+
+    /**
+     * Prints the report to the console.
+     */
+    void Print() const;
+
+    /**
+     * Allocator for a new instance. Overwritten for memory-management
+     * purpose.
+     */
+    void* operator new (size_t size) {
+        return GeAlloc(size);
+    }
+
+    /**
+     * Deallocator for class instances. Overwritten for
+     * memory-management purpose.
+     */
+    void operator delete (void* p) {
+        GeFree(p);
+    }
+
+    private:
+
+    /**
+     * Number the nodes of a subtree in pre-order.
+     * @return The index after the subtree.
+     */
+    LONG Index(const HIE_BaseNode* node, LONG index, LONG depth);
+
+    /**
+     * Evaluate the node at `index` and record its counters.
+     */
+    GeListNode* Evaluate(LONG index, GeListNode* node);
+
+    /**
+     * @return The line of the node at `index` in the report.
+     */
+    String GetLine(LONG index) const;
+
+    /**
+     * @return The label of a node in the report.
+     */
+    static String GetLabel(const HIE_BaseNode* node);
+
+};
+
+#endif /* HIE_PROFILER_H */
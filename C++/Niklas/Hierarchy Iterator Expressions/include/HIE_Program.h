@@ -0,0 +1,337 @@
+/**
+ * Simplified BSD License
+ * Copyright (C) 2013, Niklas Rosenstein. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * official policies, either expressed or implied, of the copyright
+ * holders.
+ *
+ * ***********************************************************************
+ *
+ * This header defines a flat representation of a compiled HIE. The
+ * node tree built by the HIE_Compiler is lowered into a contiguous
+ * array of opcodes that is evaluated by a single switch-dispatch
+ * interpreter instead of virtual calls through the tree.
+ */
+
+#ifndef HIE_PROGRAM_H
+#define HIE_PROGRAM_H
+
+#include "HIE.h"
+
+/**
+ * Opcodes of a HIE_Program. The interpreter keeps a single current
+ * node and a stack of saved nodes for group modes and repetitions.
+ */
+enum {
+    /**
+     * Step instructions. Applied `arg` times to the current node,
+     * stopping as soon as it becomes NULL.
+     */
+    HIE_OP_NEXT,
+    HIE_OP_PRED,
+    HIE_OP_UP,
+    HIE_OP_DOWN,
+    HIE_OP_CACHE,
+
+    /**
+     * Jump to the opcode at index `arg` when the current node is
+     * NULL.
+     */
+    HIE_OP_JUMPNULL,
+
+    /**
+     * Jump to the opcode at index `arg` when the current node is
+     * not NULL.
+     */
+    HIE_OP_JUMPFOUND,
+
+    /**
+     * Push the current node onto the stack.
+     */
+    HIE_OP_PUSH,
+
+    /**
+     * Replace the current node with the node on top of the stack.
+     */
+    HIE_OP_LOAD,
+
+    /**
+     * Remove the node on top of the stack.
+     */
+    HIE_OP_POP,
+
+    /**
+     * Remove the node on top of the stack and make it the current
+     * node if the current node is NULL.
+     */
+    HIE_OP_RESTORE,
+
+    /**
+     * Set the current node to NULL.
+     */
+    HIE_OP_CLEAR,
+
+    /**
+     * Closes the body of a repetition that was opened with
+     * HIE_OP_PUSH. When the body reached a new node, it is stored on
+     * top of the stack and execution jumps back to the body at index
+     * `arg`.
+     */
+    HIE_OP_LOOP,
+
+    /**
+     * Ends a repetition. The current node becomes the last node the
+     * body reached, or NULL when the body succeeded less than `arg`
+     * times. Removes the entry on top of the stack.
+     */
+    HIE_OP_ENDREPEAT,
+
+    /**
+     * Filters. Set the current node to NULL unless it passes the test
+     * of HIE_FilterNode::Match() against `arg`, in the order of the
+     * HIE_FilterNode::FILTER_* values. The HIE_OP_NOT* variants
+     * invert the test.
+     */
+    HIE_OP_TYPE,
+    HIE_OP_TAG,
+    HIE_OP_NAME,
+    HIE_OP_BIT,
+    HIE_OP_NOTTYPE,
+    HIE_OP_NOTTAG,
+    HIE_OP_NOTNAME,
+    HIE_OP_NOTBIT,
+};
+
+/**
+ * An entry on the stack of a HIE_Program evaluation.
+ */
+struct HIE_Frame {
+
+    /**
+     * The saved node.
+     */
+    GeListNode* node;
+
+    /**
+     * The number of repetitions, used by HIE_OP_LOOP.
+     */
+    LONG count;
+
+};
+
+/**
+ * A single instruction in a HIE_Program.
+ */
+struct HIE_Op {
+
+    /**
+     * The opcode, one of the HIE_OP_* values.
+     */
+    LONG code;
+
+    /**
+     * The argument of the opcode. A repeat count for step
+     * instructions or the target index for jumps.
+     */
+    LONG arg;
+
+};
+
+/**
+ * A compiled HIE lowered into a flat opcode array. It produces the
+ * same results as the node tree it was assembled from and may be
+ * used in place of it. Like the node tree, a program may be evaluated
+ * from multiple threads at once as long as it is not re-assembled.
+ */
+class HIE_Program {
+
+    /**
+     * The opcodes of the program.
+     */
+    HIE_Op* ops;
+
+    /**
+     * The number of opcodes.
+     */
+    LONG count;
+
+    /**
+     * The maximum number of stack entries required for evaluation.
+     */
+    LONG stackSize;
+
+    /**
+     * TRUE when `ops` is owned by the caller, see Load().
+     */
+    Bool borrowed;
+
+    public:
+
+    /**
+     * The number of stack entries the evaluation can serve without
+     * allocating memory.
+     */
+    static const LONG LOCAL_STACK = 32;
+
+    /**
+     * The number of nodes evaluated side by side by GetNextNodes().
+     */
+    static const LONG BATCH_SIZE = 256;
+
+    /**
+     * Initialize an empty program. An empty program returns the
+     * node passed to it.
+     */
+    HIE_Program() : ops(NULL), count(0), stackSize(0), borrowed(FALSE) {}
+
+    /**
+     * Destructor.
+     */
+    ~HIE_Program() {
+        Free();
+    }
+
+    /**
+     * Lower a node tree into this program, replacing the previous
+     * opcodes.
+     * @param root The root of the tree. Assumed to be not NULL.
+     * @return TRUE on success, FALSE if the tree contains nodes
+     * unknown to the assembler or memory could not be allocated.
+     */
+    Bool Assemble(const HIE_BaseNode* root);
+
+    /**
+     * Use opcodes owned by the caller, e.g. from a memory-mapped
+     * HIE_ProgramTable, replacing the previous opcodes. The opcodes
+     * are verified but not copied and must outlive the program.
+     * @param ops The opcodes.
+     * @param count The number of opcodes.
+     * @return TRUE on success, FALSE if the opcodes do not form a
+     * valid program. The program is empty in that case.
+     */
+    Bool Load(const HIE_Op* ops, LONG count);
+
+    /**
+     * Checks that a program can be evaluated safely: opcodes and jump
+     * targets are in range, conditional jumps go forward, repetitions
+     * loop back and every opcode is reached with the same stack depth
+     * on all paths.
+     * @param ops The opcodes.
+     * @param count The number of opcodes.
+     * @param stackSize Receives the maximum stack depth. May be NULL.
+     * @return TRUE if the opcodes are valid, FALSE if not.
+     */
+    static Bool Verify(const HIE_Op* ops, LONG count, LONG* stackSize);
+
+    /**
+     * Deallocate the opcodes.
+     */
+    void Free() {
+        if (ops && !borrowed) {
+            GeFree(ops);
+        }
+        ops = NULL;
+        count = 0;
+        stackSize = 0;
+        borrowed = FALSE;
+    }
+
+    /**
+     * Evaluates the program. Equal to HIE_BaseNode::GetNextNode()
+     * of the node tree the program was assembled from.
+     * @param node The start node. May be NULL in which case NULL
+     * is returned.
+     * @return The resulting node. May be NULL.
+     */
+    GeListNode* GetNextNode(GeListNode* node) const;
+
+    /**
+     * Evaluates the program for a batch of nodes. The batch is
+     * processed in chunks of BATCH_SIZE nodes, executing each opcode
+     * for every node of the chunk that reached it before moving on to
+     * the next opcode.
+     * @param input The nodes to start from. NULL entries yield NULL.
+     * @param output Receives the resulting nodes. May be equal to
+     * `input`.
+     * @param count The number of nodes in the batch.
+     */
+    void GetNextNodes(GeListNode* const* input, GeListNode** output,
+                      LONG count) const;
+
+    /**
+     * @return The number of opcodes in the program.
+     */
+    LONG GetCount() const {
+        return count;
+    }
+
+    /**
+     * @return The opcodes of the program.
+     */
+    const HIE_Op* GetOps() const {
+        return ops;
+    }
+
+    /**
+     * @return The maximum number of stack entries required.
+     */
+    LONG GetStackSize() const {
+        return stackSize;
+    }
+
+    /**
+     * Allocator for a new instance. Overwritten for memory-management
+     * purpose.
+     */
+    void* operator new (size_t size) {
+        return GeAlloc(size);
+    }
+
+    /**
+     * Deallocator for class instances. Overwritten for
+     * memory-management purpose.
+     */
+    void operator delete (void* p) {
+        GeFree(p);
+    }
+
+};
+
+/**
+ * Compile an expression with the default options and lower it into
+ * a HIE_Program.
+ * @param input The input expression.
+ * @param error Assigned the HIE_Error object when occured.
+ * @param options The options for the compiler, or NULL.
+ * @return A pointer to the program. NULL on failure.
+ */
+HIE_Program* HIE_CompileProgram(const String& input, HIE_Error* error,
+            HIE_CompilerOptions* options=NULL);
+
+#endif /* HIE_PROGRAM_H */
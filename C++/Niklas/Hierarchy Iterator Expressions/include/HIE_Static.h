@@ -0,0 +1,458 @@
+/**
+ * Simplified BSD License
+ * Copyright (C) 2013, Niklas Rosenstein. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * official policies, either expressed or implied, of the copyright
+ * holders.
+ *
+ * ***********************************************************************
+ *
+ * This header defines HIEs that are resolved at compile-time. The
+ * instructions are types with a static Get() method, so evaluating an
+ * expression is an inlined chain of GetNext(), GetDown(), ... calls
+ * without allocations or virtual calls.
+ *
+ * The types can be combined by hand:
+ *
+ *     typedef HIE_S_Group<HIE_Container::MODE_CONSECUTIVE, HIE_S_Down,
+ *             HIE_S_End<HIE_Container::MODE_CONSECUTIVE> > Expr;
+ *     GeListNode* child = HIE_Static<Expr>::GetNextNode(op);
+ *
+ * With a C++11 compiler, HIE_STATIC_EXPRESSION() parses a literal with
+ * the default HIE_CompilerOptions in strict mode instead. Invalid
+ * expressions are reported by the compiler.
+ *
+ *     HIE_STATIC_EXPRESSION(Expr, "D(?N|U)");
+ *     GeListNode* node = Expr::GetNextNode(op);
+ */
+
+#ifndef HIE_STATIC_H
+#define HIE_STATIC_H
+
+#include "HIE.h"
+
+#if __cplusplus >= 201103L || (defined(_MSC_VER) && _MSC_VER >= 1900)
+    #define HIE_STATIC_PARSER 1
+#else
+    #define HIE_STATIC_PARSER 0
+#endif
+
+/**
+ * The `N` instruction.
+ */
+struct HIE_S_Next {
+    static GeListNode* Get(GeListNode* node) {
+        return node->GetNext();
+    }
+};
+
+/**
+ * The `P` instruction.
+ */
+struct HIE_S_Pred {
+    static GeListNode* Get(GeListNode* node) {
+        return node->GetPred();
+    }
+};
+
+/**
+ * The `U` instruction.
+ */
+struct HIE_S_Up {
+    static GeListNode* Get(GeListNode* node) {
+        return node->GetUp();
+    }
+};
+
+/**
+ * The `D` instruction.
+ */
+struct HIE_S_Down {
+    static GeListNode* Get(GeListNode* node) {
+        return node->GetDown();
+    }
+};
+
+/**
+ * The `C` instruction.
+ */
+struct HIE_S_Cache {
+    static GeListNode* Get(GeListNode* node) {
+        return HIE_CacheNode::GetCache(node);
+    }
+};
+
+/**
+ * A filter, e.g. `[T5100]` for HIE_S_Filter<HIE_FilterNode::FILTER_TYPE,
+ * 5100>.
+ */
+template <LONG FILTER, LONG VALUE, Bool NEGATE=FALSE>
+struct HIE_S_Filter {
+    static GeListNode* Get(GeListNode* node) {
+        if (!node) return NULL;
+        return HIE_FilterNode::Match(FILTER, VALUE, node) != NEGATE ? node : NULL;
+    }
+};
+
+/**
+ * The OR operator, `L|R`.
+ */
+template <class L, class R>
+struct HIE_S_Or {
+    static GeListNode* Get(GeListNode* node) {
+        GeListNode* dest = L::Get(node);
+        if (!dest) dest = R::Get(node);
+        return dest;
+    }
+};
+
+/**
+ * The `*` and `+` operators, repeating `T` at least `MINIMUM` times.
+ * Behaves like a HIE_RepeatNode.
+ */
+template <class T, LONG MINIMUM>
+struct HIE_S_Repeat {
+    static GeListNode* Get(GeListNode* node) {
+        LONG count = 0;
+        while (count < HIE_RepeatNode::MAX_ITERATIONS) {
+            GeListNode* next = T::Get(node);
+            if (!next || next == node) break;
+            node = next;
+            count++;
+        }
+        return count < MINIMUM ? NULL : node;
+    }
+};
+
+/**
+ * A group of instructions, stored as the first instruction `Head` and
+ * the group of the remaining instructions `Tail`. The last `Tail` is
+ * a HIE_S_End of the same mode. Behaves like a HIE_Container of the
+ * passed mode.
+ */
+template <LONG MODE, class Head, class Tail>
+struct HIE_S_Group;
+
+/**
+ * The end of a HIE_S_Group.
+ */
+template <LONG MODE>
+struct HIE_S_End;
+
+template <class Head, class Tail>
+struct HIE_S_Group<HIE_Container::MODE_CONSECUTIVE, Head, Tail> {
+    static GeListNode* Get(GeListNode* node) {
+        GeListNode* dest = Head::Get(node);
+        return dest ? Tail::Get(dest) : NULL;
+    }
+};
+
+template <class Head, class Tail>
+struct HIE_S_Group<HIE_Container::MODE_ACCUMULATE, Head, Tail> {
+    static GeListNode* Get(GeListNode* node) {
+        GeListNode* dest = Head::Get(node);
+        return Tail::Get(dest ? dest : node);
+    }
+};
+
+template <class Head, class Tail>
+struct HIE_S_Group<HIE_Container::MODE_FIRST, Head, Tail> {
+    static GeListNode* Get(GeListNode* node) {
+        GeListNode* dest = Head::Get(node);
+        return dest ? dest : Tail::Get(node);
+    }
+};
+
+template <>
+struct HIE_S_End<HIE_Container::MODE_CONSECUTIVE> {
+    static GeListNode* Get(GeListNode* node) {
+        return node;
+    }
+};
+
+template <>
+struct HIE_S_End<HIE_Container::MODE_ACCUMULATE> {
+    static GeListNode* Get(GeListNode* node) {
+        return node;
+    }
+};
+
+template <>
+struct HIE_S_End<HIE_Container::MODE_FIRST> {
+    static GeListNode* Get(GeListNode* node) {
+        return NULL;
+    }
+};
+
+/**
+ * Entry point for evaluating a compile-time expression.
+ */
+template <class T>
+struct HIE_Static {
+
+    /**
+     * Evaluates the expression.
+     * @param node The start node. May be NULL in which case NULL is
+     * returned.
+     * @return The resulting node. May be NULL.
+     */
+    static GeListNode* GetNextNode(GeListNode* node) {
+        return node ? T::Get(node) : NULL;
+    }
+
+};
+
+/**
+ * Wraps a compile-time expression in a HIE_BaseNode, so it can be
+ * passed wherever a compiled expression is expected.
+ */
+template <class T>
+class HIE_StaticNode : public HIE_BaseNode {
+
+    public:
+
+    /* Override: HIE_BaseNode */
+    GeListNode* GetNextNode(GeListNode* node) const {
+        return T::Get(node);
+    }
+
+    /* Override: HIE_BaseNode */
+    void GetNextNodes(GeListNode* const* input, GeListNode** output,
+                      LONG count) const {
+        LONG index = 0;
+        for (; index < count; index++) {
+            GeListNode* node = input[index];
+            output[index] = node ? T::Get(node) : NULL;
+        }
+    }
+
+};
+
+#if HIE_STATIC_PARSER
+
+/**
+ * Parses the atom at position P of the source S, mirroring
+ * HIE_Compiler::ReadNode(). Provides the parsed `Type` and the
+ * position `Next` after the atom.
+ */
+template <class S, int P, char C = S::Get()[P]>
+struct HIE_SP_Atom {
+    static_assert(C != C, "HIE: expected instruction");
+    typedef HIE_S_End<HIE_Container::MODE_CONSECUTIVE> Type;
+    static const int Next = P + 1;
+};
+
+template <class S, int P>
+struct HIE_SP_Atom<S, P, 'N'> {
+    typedef HIE_S_Next Type;
+    static const int Next = P + 1;
+};
+
+template <class S, int P>
+struct HIE_SP_Atom<S, P, 'P'> {
+    typedef HIE_S_Pred Type;
+    static const int Next = P + 1;
+};
+
+template <class S, int P>
+struct HIE_SP_Atom<S, P, 'U'> {
+    typedef HIE_S_Up Type;
+    static const int Next = P + 1;
+};
+
+template <class S, int P>
+struct HIE_SP_Atom<S, P, 'D'> {
+    typedef HIE_S_Down Type;
+    static const int Next = P + 1;
+};
+
+template <class S, int P>
+struct HIE_SP_Atom<S, P, 'C'> {
+    typedef HIE_S_Cache Type;
+    static const int Next = P + 1;
+};
+
+/**
+ * Applies the `*` and `+` operators at position P to the parsed
+ * type T.
+ */
+template <class S, int P, class T, char C = S::Get()[P]>
+struct HIE_SP_Postfix {
+    typedef T Type;
+    static const int Next = P;
+};
+
+template <class S, int P, class T>
+struct HIE_SP_Postfix<S, P, T, '*'>
+    : HIE_SP_Postfix<S, P + 1, HIE_S_Repeat<T, 0> > {};
+
+template <class S, int P, class T>
+struct HIE_SP_Postfix<S, P, T, '+'>
+    : HIE_SP_Postfix<S, P + 1, HIE_S_Repeat<T, 1> > {};
+
+/**
+ * Parses an atom and its postfix operators.
+ */
+template <class S, int P, class A = HIE_SP_Atom<S, P> >
+struct HIE_SP_Operand : HIE_SP_Postfix<S, A::Next, typename A::Type> {};
+
+/**
+ * Parses an operand followed by an optional `|` and another element.
+ */
+template <class S, int P, class A = HIE_SP_Operand<S, P>,
+          bool OR = S::Get()[A::Next] == '|'>
+struct HIE_SP_Element {
+    typedef typename A::Type Type;
+    static const int Next = A::Next;
+};
+
+template <class S, int P, class A>
+struct HIE_SP_Element<S, P, A, true> {
+    typedef HIE_SP_Element<S, A::Next + 1> Right;
+    typedef HIE_S_Or<typename A::Type, typename Right::Type> Type;
+    static const int Next = Right::Next;
+};
+
+/**
+ * Parses elements up to a `)` or the end of the source into a
+ * HIE_S_Group of the passed mode. `Next` is the position of the `)` or
+ * the end.
+ */
+template <class S, int P, LONG MODE, char C = S::Get()[P]>
+struct HIE_SP_Sequence {
+    typedef HIE_SP_Element<S, P> Element;
+    typedef HIE_SP_Sequence<S, Element::Next, MODE> Rest;
+    typedef HIE_S_Group<MODE, typename Element::Type, typename Rest::Type> Type;
+    static const int Next = Rest::Next;
+};
+
+template <class S, int P, LONG MODE>
+struct HIE_SP_Sequence<S, P, MODE, ')'> {
+    typedef HIE_S_End<MODE> Type;
+    static const int Next = P;
+};
+
+template <class S, int P, LONG MODE>
+struct HIE_SP_Sequence<S, P, MODE, '\0'> {
+    typedef HIE_S_End<MODE> Type;
+    static const int Next = P;
+};
+
+/**
+ * @return The container mode selected by the character following
+ * a `(`, or -1 if it does not select a mode.
+ */
+constexpr LONG HIE_SP_Mode(char c) {
+    return c == '!' ? HIE_Container::MODE_CONSECUTIVE :
+           c == '?' ? HIE_Container::MODE_FIRST :
+           c == '~' ? HIE_Container::MODE_ACCUMULATE : -1;
+}
+
+/**
+ * @return The filter selected by the character following a `[` or
+ * `[!`, or -1 if it does not select a filter.
+ */
+constexpr LONG HIE_SP_Filter(char c) {
+    return c == 'T' ? HIE_FilterNode::FILTER_TYPE :
+           c == 'G' ? HIE_FilterNode::FILTER_TAG :
+           c == 'H' ? HIE_FilterNode::FILTER_NAME :
+           c == 'B' ? HIE_FilterNode::FILTER_BIT : -1;
+}
+
+/**
+ * @return The number of decimal digits at position p of s.
+ */
+constexpr int HIE_SP_Digits(const char* s, int p) {
+    return s[p] >= '0' && s[p] <= '9' ? 1 + HIE_SP_Digits(s, p + 1) : 0;
+}
+
+/**
+ * @return The value of the decimal digits at position p of s, added
+ * to value. Stops growing once it exceeds 32 bits.
+ */
+constexpr unsigned long long HIE_SP_Value(const char* s, int p,
+                                          unsigned long long value) {
+    return s[p] >= '0' && s[p] <= '9' && value <= 0xFFFFFFFFull ?
+           HIE_SP_Value(s, p + 1, value * 10 + (s[p] - '0')) : value;
+}
+
+/**
+ * A filter, `[` followed by an optional `!`, the filter character and
+ * a decimal value of up to 32 bits, closed by `]`.
+ */
+template <class S, int P>
+struct HIE_SP_Atom<S, P, '['> {
+    static const bool Negate = S::Get()[P + 1] == '!';
+    static const int Kind = Negate ? P + 2 : P + 1;
+    static const LONG Filter = HIE_SP_Filter(S::Get()[Kind]);
+    static_assert(Filter >= 0, "HIE: unexpected filter");
+    static const int Start = Filter < 0 ? Kind : Kind + 1;
+    static const int Digits = HIE_SP_Digits(S::Get(), Start);
+    static_assert(Digits > 0, "HIE: expected filter value");
+    static const unsigned long long Value = HIE_SP_Value(S::Get(), Start, 0);
+    static_assert(Value <= 0xFFFFFFFFull, "HIE: filter value too large");
+    static_assert(S::Get()[Start + Digits] == ']', "HIE: unexpected character");
+    typedef HIE_S_Filter<Filter, (LONG) (ULONG) Value, Negate> Type;
+    static const int Next = Start + Digits + 1;
+};
+
+template <class S, int P>
+struct HIE_SP_Atom<S, P, '('> {
+    static const LONG Mode = HIE_SP_Mode(S::Get()[P + 1]);
+    typedef HIE_SP_Sequence<S, Mode < 0 ? P + 1 : P + 2,
+            Mode < 0 ? HIE_Container::MODE_CONSECUTIVE : Mode> Group;
+    static_assert(S::Get()[Group::Next] == ')', "HIE: unexpected end of input");
+    typedef typename Group::Type Type;
+    static const int Next = Group::Next + 1;
+};
+
+/**
+ * Parses the whole source S into a HIE_Static expression.
+ */
+template <class S>
+struct HIE_StaticParse {
+    typedef HIE_SP_Sequence<S, 0, HIE_Container::MODE_CONSECUTIVE> Root;
+    static_assert(S::Get()[Root::Next] == '\0', "HIE: unexpected character");
+    typedef HIE_Static<typename Root::Type> Type;
+};
+
+/**
+ * Declares `name` as the compile-time expression parsed from the
+ * string literal `literal`. May be used at namespace or function
+ * scope.
+ */
+#define HIE_STATIC_EXPRESSION(name, literal) \
+    struct name##_Source { \
+        static constexpr const char* Get() { return literal; } \
+    }; \
+    typedef HIE_StaticParse<name##_Source>::Type name
+
+#endif /* HIE_STATIC_PARSER */
+
+#endif /* HIE_STATIC_H */
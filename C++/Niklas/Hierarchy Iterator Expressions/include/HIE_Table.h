@@ -0,0 +1,237 @@
+/**
+ * Simplified BSD License
+ * Copyright (C) 2013, Niklas Rosenstein. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * official policies, either expressed or implied, of the copyright
+ * holders.
+ *
+ * ***********************************************************************
+ *
+ * This header defines a binary format for precompiled HIEs. A table
+ * stores the opcodes of any number of HIE_Programs. It contains no
+ * pointers, so it can be memory-mapped from a file and evaluated in
+ * place without running the HIE_Compiler.
+ *
+ * Layout, all values are 32 bit integers in native byte order:
+ *
+ *     HIE_TableHeader
+ *     HIE_TableEntry[header.count]
+ *     HIE_Op[...]
+ */
+
+#ifndef HIE_TABLE_H
+#define HIE_TABLE_H
+
+#include "HIE.h"
+#include "HIE_Program.h"
+
+/**
+ * Identifies a HIE table, the characters `HIET`. Also detects a
+ * table written with a different byte order.
+ */
+static const LONG HIE_TABLE_MAGIC = 0x48494554;
+
+/**
+ * The version of the table format. Incremented whenever the layout
+ * or the meaning of an opcode changes.
+ */
+static const LONG HIE_TABLE_VERSION = 2;
+
+/**
+ * The beginning of a table.
+ */
+struct HIE_TableHeader {
+
+    /**
+     * HIE_TABLE_MAGIC.
+     */
+    LONG magic;
+
+    /**
+     * HIE_TABLE_VERSION of the writer.
+     */
+    LONG version;
+
+    /**
+     * The number of programs in the table.
+     */
+    LONG count;
+
+    /**
+     * The size of the whole table in bytes.
+     */
+    LONG size;
+
+};
+
+/**
+ * Locates a program in a table.
+ */
+struct HIE_TableEntry {
+
+    /**
+     * The offset of the first opcode from the beginning of the table,
+     * in bytes.
+     */
+    LONG offset;
+
+    /**
+     * The number of opcodes.
+     */
+    LONG count;
+
+};
+
+/**
+ * Read access to a table of precompiled programs. The table is used
+ * in place, its memory must stay valid while the HIE_ProgramTable
+ * exists.
+ */
+class HIE_ProgramTable {
+
+    /**
+     * The programs, borrowing their opcodes from the table.
+     */
+    HIE_Program** programs;
+
+    /**
+     * The number of programs.
+     */
+    LONG count;
+
+    public:
+
+    /**
+     * Initialize an empty table.
+     */
+    HIE_ProgramTable() : programs(NULL), count(0) {}
+
+    /**
+     * Destructor.
+     */
+    ~HIE_ProgramTable() {
+        Free();
+    }
+
+    /**
+     * Use a table in memory, e.g. a memory-mapped file. The header,
+     * the entries and every program are verified, see
+     * HIE_Program::Verify().
+     * @param memory The table, aligned to 4 bytes.
+     * @param size The size of the memory in bytes.
+     * @return TRUE on success, FALSE if the memory does not hold a
+     * valid table of this version.
+     */
+    Bool Load(const void* memory, LONG size);
+
+    /**
+     * Release the programs. The table memory is not touched.
+     */
+    void Free();
+
+    /**
+     * @return The number of programs.
+     */
+    LONG GetCount() const {
+        return count;
+    }
+
+    /**
+     * @param index The index of the program, in the order it was
+     * added to the HIE_ProgramTableWriter.
+     * @return The program. Owned by the table.
+     */
+    const HIE_Program* GetProgram(LONG index) const {
+        return programs[index];
+    }
+
+};
+
+/**
+ * Collects programs and writes them as a table.
+ */
+class HIE_ProgramTableWriter {
+
+    /**
+     * The opcodes of all programs.
+     */
+    GeDynamicArray<HIE_Op> ops;
+
+    /**
+     * The number of opcodes of each program.
+     */
+    GeDynamicArray<LONG> counts;
+
+    public:
+
+    /**
+     * Assemble a compiled expression and add it to the table.
+     * @param root The root of the expression, e.g. a HIE_Container
+     * returned by the HIE_Compiler.
+     * @return TRUE on success, FALSE if the expression could not be
+     * assembled or memory could not be allocated.
+     */
+    Bool Add(const HIE_BaseNode* root);
+
+    /**
+     * Add an assembled program to the table.
+     * @return TRUE on success, FALSE if memory could not be allocated.
+     */
+    Bool Add(const HIE_Program* program);
+
+    /**
+     * @return The number of programs added.
+     */
+    LONG GetCount() const {
+        return counts.GetCount();
+    }
+
+    /**
+     * @return The size of the table in bytes.
+     */
+    LONG GetSize() const;
+
+    /**
+     * Write the table to memory.
+     * @param memory The destination, aligned to 4 bytes.
+     * @param size The size of the destination in bytes.
+     * @return TRUE on success, FALSE if the destination is too small.
+     */
+    Bool Write(void* memory, LONG size) const;
+
+    /**
+     * Write the table to a file.
+     * @param filename The file to write.
+     * @return TRUE on success, FALSE if not.
+     */
+    Bool WriteFile(const Filename& filename) const;
+
+};
+
+#endif /* HIE_TABLE_H */
@@ -37,138 +37,910 @@
  */
 
 #include "HIE.h"
+#include "HIE_Optimizer.h"
 
-HIE_Container* HIE_Compiler::Compile(String input, HIE_ErrorLog* log) const {
-    HIE_Container* container = new HIE_Container;
-    if (!container) return NULL;
+/**
+ * Evaluates a list of nodes on a single node and returns the first
+ * node found.
+ */
+static GeListNode* HIE_FirstOf(HIE_BaseNode* const* nodes, LONG nodeCount,
+                               GeListNode* node) {
+    GeListNode* dest = NULL;
+    LONG index = 0;
+    for (; index < nodeCount && !dest; index++) {
+        dest = nodes[index]->GetNextNode(node);
+    }
+    return dest;
+}
 
-    HIE_BaseNode* node;
-    HIE_InputScanner scanner(input);
-    scanner.Read();
+/**
+ * Evaluates a list of nodes on a batch of nodes and returns the first
+ * node found for each entry. Only entries that are still unresolved
+ * are passed to the next node in the list.
+ */
+static void HIE_FirstOfBatch(HIE_BaseNode* const* nodes, LONG nodeCount,
+                             GeListNode* const* input, GeListNode** output,
+                             LONG count) {
+    LONG index = 0;
+    LONG i;
 
-    while (!scanner.End()) {
-        node = ReadNode(scanner, log);
-        container->Push(node);
-        if (log->IsFatal()) {
-            break;
+    // The input must be preserved while the output is written since
+    // both may point to the same array.
+    GeListNode** source = (GeListNode**) GeAlloc(sizeof(GeListNode*) * count * 2);
+    if (!source) {
+        for (i = 0; i < count; i++) {
+            GeListNode* node = input[i];
+            output[i] = node ? HIE_FirstOf(nodes, nodeCount, node) : NULL;
         }
+        return;
     }
+    GeListNode** pending = source + count;
+    memcpy(source, input, sizeof(GeListNode*) * count);
 
-    // Deallocate the container on a fatal error.
-    if (log->IsFatal()) {
-        delete container;
-        container = NULL;
+    for (i = 0; i < count; i++) {
+        output[i] = NULL;
     }
 
-    return container;
-}
+    for (; index < nodeCount; index++) {
+        LONG active = 0;
+        for (i = 0; i < count; i++) {
+            pending[i] = output[i] ? NULL : source[i];
+            if (pending[i]) active++;
+        }
+        if (!active) break;
 
-HIE_BaseNode* HIE_Compiler::ReadNode(HIE_InputScanner& scanner,
-                                     HIE_ErrorLog* log) const {
-    if (scanner.End()) return NULL;
-    char current = scanner.Chr();
+        nodes[index]->GetNextNodes(pending, pending, count);
+        for (i = 0; i < count; i++) {
+            if (!output[i]) output[i] = pending[i];
+        }
+    }
 
-    HIE_BaseNode* node = NULL;
+    GeFree(source);
+}
 
-    if (current == options.instr_Gopen) {
-        scanner.Read();
+void HIE_OrOperatorNode::GetNextNodes(GeListNode* const* input,
+                                      GeListNode** output, LONG count) const {
+    HIE_BaseNode* nodes[2] = { left, right };
+    HIE_FirstOfBatch(nodes, 2, input, output, count);
+}
 
-        // Create the node-container and define it's mode.
-        HIE_Container* container = new HIE_Container;
-        if (!scanner.End()) {
-            current = scanner.Chr();
+void HIE_Container::GetNextNodes(GeListNode* const* input,
+                                 GeListNode** output, LONG count) const {
+    LONG size = this->count;
+    LONG index = 0;
+    LONG i;
 
-            Bool skip = TRUE;
-            if (current == options.instr_Gconsecutive) {
-                container->mode = HIE_Container::MODE_CONSECUTIVE;
-            }
-            else if (current == options.instr_Gfirst) {
-                container->mode = HIE_Container::MODE_FIRST;
-            }
-            else if (current == options.instr_Gaccum) {
-                container->mode = HIE_Container::MODE_ACCUMULATE;
+    switch (mode) {
+        case MODE_CONSECUTIVE:
+            if (output != input)
+                memcpy(output, input, sizeof(GeListNode*) * count);
+            for (; index < size; index++)
+                nodes[index]->GetNextNodes(output, output, count);
+            break;
+        case MODE_ACCUMULATE: {
+            GeListNode** scratch = NULL;
+            if (size > 0) {
+                scratch = (GeListNode**) GeAlloc(sizeof(GeListNode*) * count);
+                if (!scratch) {
+                    HIE_BaseNode::GetNextNodes(input, output, count);
+                    break;
+                }
             }
-            else {
-                skip = FALSE;
+            if (output != input)
+                memcpy(output, input, sizeof(GeListNode*) * count);
+            for (; index < size; index++) {
+                nodes[index]->GetNextNodes(output, scratch, count);
+                for (i = 0; i < count; i++) {
+                    if (scratch[i]) output[i] = scratch[i];
+                }
             }
-            if (skip) scanner.Read();
+            if (scratch) GeFree(scratch);
+            break;
         }
+        case MODE_FIRST:
+            HIE_FirstOfBatch(nodes, size, input, output, count);
+            break;
+        default:
+            for (i = 0; i < count; i++)
+                output[i] = NULL;
+            break;
+    }
+}
+
+/**
+ * Passes the nodes yielded by a node of a container on to the
+ * remaining nodes of the container.
+ */
+class HIE_ChainSink : public HIE_Sink {
+
+    const HIE_Container* container;
+    LONG index;
+    HIE_Sink* sink;
+
+    public:
+
+    /**
+     * The number of nodes received.
+     */
+    LONG count;
+
+    HIE_ChainSink(const HIE_Container* container, LONG index, HIE_Sink* sink)
+    : container(container), index(index), sink(sink), count(0) {}
+
+    /* Override: HIE_Sink */
+    Bool Push(GeListNode* node) {
+        count++;
+        return container->EnumerateFrom(index, node, sink);
+    }
+
+};
+
+/**
+ * Passes the nodes yielded by the node of a HIE_RepeatNode on to the
+ * sink and repeats the node on them.
+ */
+class HIE_RepeatSink : public HIE_Sink {
+
+    const HIE_RepeatNode* repeat;
+    GeListNode* start;
+    HIE_Sink* sink;
+    LONG depth;
+
+    public:
+
+    HIE_RepeatSink(const HIE_RepeatNode* repeat, GeListNode* start,
+                   HIE_Sink* sink, LONG depth)
+    : repeat(repeat), start(start), sink(sink), depth(depth) {}
+
+    /* Override: HIE_Sink */
+    Bool Push(GeListNode* node) {
+        // A node that leads back to itself ends the repetition.
+        if (node == start) return TRUE;
+        if (!sink->Push(node)) return FALSE;
+        return repeat->EnumerateFrom(node, sink, depth);
+    }
+
+};
+
+Bool HIE_OrOperatorNode::Enumerate(GeListNode* node, HIE_Sink* sink) const {
+    HIE_CountingSink counter(sink);
+    if (!left->Enumerate(node, &counter)) return FALSE;
+    if (counter.count) return TRUE;
+    return right->Enumerate(node, sink);
+}
+
+Bool HIE_RepeatNode::Enumerate(GeListNode* start, HIE_Sink* sink) const {
+    if (minimum == 0 && !sink->Push(start)) return FALSE;
 
-        // Read the nodes for the group.
-        while (!scanner.End() && scanner.Chr() != options.instr_Gclose) {
-            node = ReadNode(scanner, log);
-            if (!node) break;
-            container->Push(node);
+    // Single-valued nodes form a chain that is walked without
+    // recursion.
+    if (!node->IsMultiValued()) {
+        GeListNode* dest = start;
+        LONG count = 0;
+        while (count < MAX_ITERATIONS) {
+            GeListNode* next = node->GetNextNode(dest);
+            if (!next || next == dest) break;
+            if (!sink->Push(next)) return FALSE;
+            dest = next;
+            count++;
         }
+        return TRUE;
+    }
 
-        // If there was not already a fatal error, check if there should
-        // be one.
-        if (!log->IsFatal()) {
-            if (scanner.End()) {
-                HIE_Error error(HIE_EOI);
-                log->Push(error);
-                log->SetFatal();
-            }
-            else if (scanner.Chr() != options.instr_Gclose) {
-                HIE_Error error(HIE_UNEXPECTEDCHARACTER, scanner.Chr(),
-                                scanner.GetPosition());
-                log->Push(error);
-                log->SetFatal();
+    return EnumerateFrom(start, sink, 0);
+}
+
+Bool HIE_RepeatNode::EnumerateFrom(GeListNode* start, HIE_Sink* sink,
+                                   LONG depth) const {
+    if (depth >= MAX_DEPTH) return TRUE;
+    HIE_RepeatSink repeat(this, start, sink, depth + 1);
+    return node->Enumerate(start, &repeat);
+}
+
+Bool HIE_Container::Enumerate(GeListNode* node, HIE_Sink* sink) const {
+    if (!multi) return HIE_BaseNode::Enumerate(node, sink);
+
+    LONG index = 0;
+    switch (mode) {
+        case MODE_CONSECUTIVE:
+        case MODE_ACCUMULATE:
+            return EnumerateFrom(0, node, sink);
+        case MODE_FIRST:
+            for (; index < count; index++) {
+                HIE_CountingSink counter(sink);
+                if (!nodes[index]->Enumerate(node, &counter)) return FALSE;
+                if (counter.count) break;
             }
+            return TRUE;
+        default:
+            return TRUE;
+    }
+}
+
+Bool HIE_Container::EnumerateFrom(LONG index, GeListNode* node,
+                                  HIE_Sink* sink) const {
+    // Single-valued nodes are applied in place, only multi-valued
+    // nodes branch into the remaining nodes.
+    for (; index < count; index++) {
+        HIE_BaseNode* child = nodes[index];
+        if (child->IsMultiValued()) break;
+
+        GeListNode* dest = child->GetNextNode(node);
+        if (dest) node = dest;
+        else if (mode == MODE_CONSECUTIVE) return TRUE;
+    }
+    if (index >= count) return sink->Push(node);
+
+    HIE_ChainSink chain(this, index + 1, sink);
+    if (!nodes[index]->Enumerate(node, &chain)) return FALSE;
+
+    // An accumulative container continues with the last node if the
+    // multi-valued node did not yield anything.
+    if (mode == MODE_ACCUMULATE && chain.count == 0)
+        return EnumerateFrom(index + 1, node, sink);
+    return TRUE;
+}
+
+/**
+ * A construct the HIE_Compiler is in the middle of parsing, kept on
+ * an explicit stack instead of the call stack.
+ */
+struct HIE_ParseFrame {
+
+    /**
+     * A group whose nodes are being read. `node` is the container,
+     * `base` the number of pending nodes when the group was opened.
+     */
+    static const LONG FRAME_GROUP = 0;
+
+    /**
+     * An `|` operator waiting for its right-hand node. `node` is the
+     * left-hand node, NULL if it was skipped in loose mode, `base`
+     * the position of the operator.
+     */
+    static const LONG FRAME_OR = 1;
+
+    LONG type;
+    HIE_BaseNode* node;
+    LONG base;
+
+};
+
+/**
+ * State shared by the HIE_Compiler while parsing a single expression.
+ * Allocates nodes either individually or in a HIE_Arena and collects
+ * the nodes of the groups that are currently being parsed.
+ */
+class HIE_CompileContext {
+
+    /**
+     * The nodes of all open groups, innermost group last.
+     */
+    HIE_BaseNode** pending;
+
+    /**
+     * The number of nodes in `pending`.
+     */
+    LONG count;
+
+    /**
+     * The number of nodes `pending` can hold.
+     */
+    LONG capacity;
+
+    /**
+     * The open groups and operators, innermost last.
+     */
+    HIE_ParseFrame* frames;
+
+    /**
+     * The number of entries in `frames`.
+     */
+    LONG frameCount;
+
+    /**
+     * The number of entries `frames` can hold.
+     */
+    LONG frameCapacity;
+
+    public:
+
+    /**
+     * The arena to allocate nodes in, or NULL to allocate them
+     * individually.
+     */
+    HIE_Arena* arena;
+
+    HIE_CompileContext(HIE_Arena* arena)
+    : pending(NULL), count(0), capacity(0), frames(NULL), frameCount(0),
+      frameCapacity(0), arena(arena) {}
+
+    ~HIE_CompileContext() {
+        while (count > 0) {
+            Discard(pending[--count]);
+        }
+        if (pending) GeFree(pending);
+        if (frames) GeFree(frames);
+    }
+
+    /**
+     * Open a group or operator.
+     * @return TRUE on success, FALSE if memory could not be allocated.
+     */
+    Bool PushFrame(LONG type, HIE_BaseNode* node, LONG base) {
+        if (frameCount == frameCapacity) {
+            LONG size = frameCapacity ? frameCapacity * 2 : 16;
+            HIE_ParseFrame* array = (HIE_ParseFrame*) GeAlloc(sizeof(HIE_ParseFrame) * size);
+            if (!array) return FALSE;
+            if (frameCount) memcpy(array, frames, sizeof(HIE_ParseFrame) * frameCount);
+            if (frames) GeFree(frames);
+            frames = array;
+            frameCapacity = size;
         }
+        HIE_ParseFrame& frame = frames[frameCount++];
+        frame.type = type;
+        frame.node = node;
+        frame.base = base;
+        return TRUE;
+    }
+
+    /**
+     * @return The innermost open group or operator, NULL if there is
+     * none.
+     */
+    HIE_ParseFrame* GetFrame() {
+        return frameCount ? &frames[frameCount - 1] : NULL;
+    }
 
-        node = container;
+    /**
+     * Close the innermost group or operator.
+     */
+    void PopFrame() {
+        frameCount--;
     }
-    else if (current == options.instr_N) {
-        node = new HIE_NextNode;
+
+    /**
+     * Allocate a node.
+     */
+    template <class T>
+    T* New() {
+        if (arena) return new (arena) T;
+        return new T;
     }
-    else if (current == options.instr_P) {
-        node = new HIE_PredNode;
+
+    /**
+     * Allocate an OR operator node.
+     */
+    HIE_OrOperatorNode* NewOr(HIE_BaseNode* left, HIE_BaseNode* right) {
+        if (arena) return new (arena) HIE_OrOperatorNode(left, right);
+        return new HIE_OrOperatorNode(left, right);
     }
-    else if (current == options.instr_D) {
-        node = new HIE_DownNode;
+
+    /**
+     * Allocate a repetition node.
+     */
+    HIE_RepeatNode* NewRepeat(HIE_BaseNode* node, LONG minimum) {
+        if (arena) return new (arena) HIE_RepeatNode(node, minimum);
+        return new HIE_RepeatNode(node, minimum);
     }
-    else if (current == options.instr_U) {
-        node = new HIE_UpNode;
+
+    /**
+     * Allocate a filter node.
+     */
+    HIE_FilterNode* NewFilter(LONG filter, LONG value, Bool negate) {
+        if (arena) return new (arena) HIE_FilterNode(filter, value, negate);
+        return new HIE_FilterNode(filter, value, negate);
     }
-    else if (current == options.instr_C && options.instr_C_supported) {
-        node = new HIE_CacheNode;
+
+    /**
+     * Deallocate a node that is not used. Nodes in an arena are freed
+     * with the arena.
+     */
+    void Discard(HIE_BaseNode* node) {
+        if (!arena) delete node;
     }
-    else if (options.mode == HIE_CompilerOptions::MODE_STRICT) {
-        HIE_Error error(HIE_UNEXPECTEDCHARACTER, current,
-                        scanner.GetPosition());
-        log->Push(error);
+
+    /**
+     * @return The number of pending nodes, used to mark the beginning
+     * of a group.
+     */
+    LONG GetCount() const {
+        return count;
+    }
+
+    /**
+     * Add a node to the innermost open group.
+     */
+    Bool Push(HIE_BaseNode* node) {
+        if (count == capacity) {
+            LONG size = capacity ? capacity * 2 : 16;
+            HIE_BaseNode** array = (HIE_BaseNode**) GeAlloc(sizeof(HIE_BaseNode*) * size);
+            if (!array) {
+                Discard(node);
+                return FALSE;
+            }
+            if (count) memcpy(array, pending, sizeof(HIE_BaseNode*) * count);
+            if (pending) GeFree(pending);
+            pending = array;
+            capacity = size;
+        }
+        pending[count++] = node;
+        return TRUE;
+    }
+
+    /**
+     * Move the pending nodes starting at `base` into a container.
+     * @return TRUE on success, FALSE if memory could not be allocated.
+     * The nodes are deallocated in that case.
+     */
+    Bool Finish(HIE_Container* container, LONG base) {
+        LONG size = count - base;
+        LONG index = 0;
+        Bool success = TRUE;
+
+        if (arena) {
+            HIE_BaseNode** array = NULL;
+            if (size > 0) {
+                array = (HIE_BaseNode**) arena->Alloc(sizeof(HIE_BaseNode*) * size);
+                success = array != NULL;
+            }
+            if (success) {
+                if (size > 0)
+                    memcpy(array, pending + base, sizeof(HIE_BaseNode*) * size);
+                container->Borrow(array, size);
+            }
+        }
+        else if (container->Reserve(size)) {
+            for (; index < size; index++)
+                container->Push(pending[base + index]);
+        }
+        else {
+            for (; index < size; index++)
+                Discard(pending[base + index]);
+            success = FALSE;
+        }
+
+        count = base;
+        return success;
+    }
+
+};
+
+LONG HIE_Compiler::GetArenaSize(LONG length) {
+    // Every character of the input creates at most one node and the
+    // root container is added on top. Each node takes a slot in the
+    // array of its container.
+    LONG node = sizeof(HIE_Container);
+    if (node < (LONG) sizeof(HIE_OrOperatorNode))
+        node = sizeof(HIE_OrOperatorNode);
+    if (node < (LONG) sizeof(HIE_RepeatNode))
+        node = sizeof(HIE_RepeatNode);
+    if (node < (LONG) sizeof(HIE_StepNode))
+        node = sizeof(HIE_StepNode);
+    if (node < (LONG) sizeof(HIE_FilterNode))
+        node = sizeof(HIE_FilterNode);
+    node += sizeof(HIE_BaseNode*) + 2 * HIE_Arena::ALIGNMENT;
+
+    LLONG size = ((LLONG) length + 1) * node;
+    if (length < 0 || size > 0x7fffffff) return -1;
+    return (LONG) size;
+}
+
+HIE_Container* HIE_Compiler::Compile(const String& input, HIE_ErrorLog* log) const {
+    HIE_InputScanner scanner(input);
+    HIE_CompileContext context(NULL);
+    return Compile(scanner, log, context);
+}
+
+HIE_Container* HIE_Compiler::Compile(const char* input, LONG length,
+            HIE_ErrorLog* log) const {
+    HIE_InputScanner scanner(input, length);
+    HIE_CompileContext context(NULL);
+    return Compile(scanner, log, context);
+}
+
+HIE_Container* HIE_Compiler::Compile(const char* input, LONG length,
+            HIE_ErrorLog* log, HIE_Arena* arena) const {
+    HIE_InputScanner scanner(input, length);
+    HIE_CompileContext context(arena);
+    return Compile(scanner, log, context);
+}
+
+HIE_Expression* HIE_Compiler::CompileExpression(const String& input,
+            HIE_ErrorLog* log) const {
+    HIE_InputScanner scanner(input);
+    return CompileExpression(scanner, log);
+}
+
+HIE_Expression* HIE_Compiler::CompileExpression(const char* input,
+            LONG length, HIE_ErrorLog* log) const {
+    HIE_InputScanner scanner(input, length);
+    return CompileExpression(scanner, log);
+}
+
+HIE_Expression* HIE_Compiler::CompileExpression(HIE_InputScanner& scanner,
+            HIE_ErrorLog* log) const {
+    HIE_Arena arena;
+    LONG size = GetArenaSize(scanner.GetLength());
+    if (size < 0 || !arena.Init(size)) return NULL;
+
+    HIE_CompileContext context(&arena);
+    HIE_Container* root = Compile(scanner, log, context);
+    if (!root) return NULL;
+
+    return new HIE_Expression(root, arena);
+}
+
+HIE_Container* HIE_Compiler::Compile(HIE_InputScanner& scanner,
+            HIE_ErrorLog* log, HIE_CompileContext& context) const {
+    HIE_Container* container = context.New<HIE_Container>();
+    if (!container) return NULL;
+
+    HIE_BaseNode* node;
+    scanner.Read();
+
+    while (!scanner.End()) {
+        node = ReadNode(scanner, log, context);
+        if (node && !context.Push(node)) {
+            log->SetFatal();
+        }
+        if (log->IsFatal()) {
+            break;
+        }
+    }
+
+    if (!context.Finish(container, 0)) {
         log->SetFatal();
     }
 
+    if (!log->IsFatal() && options.optimize) {
+        HIE_Optimize(container, context.arena, NULL);
+    }
+
+    // Deallocate the container on a fatal error.
     if (log->IsFatal()) {
-        delete node;
-        return NULL;
+        context.Discard(container);
+        container = NULL;
     }
 
+    return container;
+}
+
+HIE_BaseNode* HIE_Compiler::ReadFilter(HIE_InputScanner& scanner,
+            HIE_ErrorLog* log, HIE_CompileContext& context) const {
+    // Malformed filters are errors in loose mode as well, skipping
+    // their characters would change the meaning of the expression.
+    Bool negate = FALSE;
+    LONG filter = -1;
+    ULONG value = 0;
+    LONG digits = 0;
+    char current;
+
     scanner.Read();
-    if (scanner.End()) return node;
+    if (!scanner.End() && scanner.Chr() == options.instr_Fnot) {
+        negate = TRUE;
+        scanner.Read();
+    }
 
-    // Check for the | operator.
-    current = scanner.Chr();
-    if (current == options.instr_Or) {
+    if (!scanner.End()) {
+        current = scanner.Chr();
+        if (current == options.instr_Ftype)
+            filter = HIE_FilterNode::FILTER_TYPE;
+        else if (current == options.instr_Ftag)
+            filter = HIE_FilterNode::FILTER_TAG;
+        else if (current == options.instr_Fname)
+            filter = HIE_FilterNode::FILTER_NAME;
+        else if (current == options.instr_Fbit)
+            filter = HIE_FilterNode::FILTER_BIT;
+
+        if (filter < 0) {
+            HIE_Error error(HIE_UNEXPECTEDCHARACTER, current,
+                            scanner.GetPosition());
+            log->Push(error);
+            log->SetFatal();
+            return NULL;
+        }
         scanner.Read();
-        HIE_BaseNode* nextNode = ReadNode(scanner, log);
-        if (!nextNode) {
-            LONG position = scanner.GetPosition();
-            HIE_Error error(HIE_EXPECTEDINSTRUCTION, position);
+    }
+
+    // The value is a decimal number of up to 32 bits.
+    while (!scanner.End()) {
+        current = scanner.Chr();
+        if (current < '0' || current > '9') break;
+        ULONG digit = current - '0';
+        if (value > (0xFFFFFFFFu - digit) / 10) {
+            HIE_Error error(HIE_UNEXPECTEDCHARACTER, current,
+                            scanner.GetPosition());
             log->Push(error);
             log->SetFatal();
-            delete node;
             return NULL;
         }
-        node = new HIE_OrOperatorNode(node, nextNode);
+        value = value * 10 + digit;
+        digits++;
+        scanner.Read();
+    }
+
+    if (scanner.End()) {
+        HIE_Error error(HIE_EOI);
+        log->Push(error);
+        log->SetFatal();
+        return NULL;
+    }
+    current = scanner.Chr();
+    if (digits == 0 || current != options.instr_Fclose) {
+        HIE_Error error(HIE_UNEXPECTEDCHARACTER, current,
+                        scanner.GetPosition());
+        log->Push(error);
+        log->SetFatal();
+        return NULL;
     }
 
+    HIE_BaseNode* node = context.NewFilter(filter, (LONG) value, negate);
+    if (!node) log->SetFatal();
     return node;
 }
 
-HIE_Container* HIE_CompileExpression(String input, HIE_Error* error,
+/**
+ * The states of HIE_Compiler::ReadNode().
+ */
+enum {
+    /**
+     * Read a node at the current position.
+     */
+    HIE_PARSE_NODE,
+
+    /**
+     * Read the next node of the innermost group or close it.
+     */
+    HIE_PARSE_GROUP,
+
+    /**
+     * Close the innermost group.
+     */
+    HIE_PARSE_CLOSE,
+
+    /**
+     * Read the operators following a node.
+     */
+    HIE_PARSE_POSTFIX,
+
+    /**
+     * A node was read, hand it to the innermost group or operator.
+     */
+    HIE_PARSE_DONE,
+};
+
+HIE_BaseNode* HIE_Compiler::ReadNode(HIE_InputScanner& scanner,
+            HIE_ErrorLog* log, HIE_CompileContext& context) const {
+    // Groups and `|` operands nest arbitrarily deep. Instead of
+    // recursing, the open groups and operators are kept on the stack
+    // of the context and every character is visited once.
+    HIE_BaseNode* node = NULL;
+    LONG state = HIE_PARSE_NODE;
+    LONG position = -1;
+    char current;
+
+    while (TRUE) {
+        switch (state) {
+            case HIE_PARSE_NODE: {
+                node = NULL;
+                state = HIE_PARSE_DONE;
+                if (scanner.End()) break;
+                current = scanner.Chr();
+                position = scanner.GetPosition();
+
+                if (current == options.instr_Gopen) {
+                    scanner.Read();
+
+                    // Create the node-container and define it's mode.
+                    HIE_Container* container = context.New<HIE_Container>();
+                    if (!container) {
+                        log->SetFatal();
+                        break;
+                    }
+                    container->SetPosition(position);
+                    if (!scanner.End()) {
+                        current = scanner.Chr();
+
+                        Bool skip = TRUE;
+                        if (current == options.instr_Gconsecutive) {
+                            container->mode = HIE_Container::MODE_CONSECUTIVE;
+                        }
+                        else if (current == options.instr_Gfirst) {
+                            container->mode = HIE_Container::MODE_FIRST;
+                        }
+                        else if (current == options.instr_Gaccum) {
+                            container->mode = HIE_Container::MODE_ACCUMULATE;
+                        }
+                        else {
+                            skip = FALSE;
+                        }
+                        if (skip) scanner.Read();
+                    }
+
+                    if (!context.PushFrame(HIE_ParseFrame::FRAME_GROUP,
+                                           container, context.GetCount())) {
+                        context.Discard(container);
+                        log->SetFatal();
+                        break;
+                    }
+                    state = HIE_PARSE_GROUP;
+                    break;
+                }
+                else if (current == options.instr_N) {
+                    node = context.New<HIE_NextNode>();
+                }
+                else if (current == options.instr_P) {
+                    node = context.New<HIE_PredNode>();
+                }
+                else if (current == options.instr_D) {
+                    node = context.New<HIE_DownNode>();
+                }
+                else if (current == options.instr_U) {
+                    node = context.New<HIE_UpNode>();
+                }
+                else if (current == options.instr_C && options.instr_C_supported) {
+                    node = context.New<HIE_CacheNode>();
+                }
+                else if (current == options.instr_Fopen && options.instr_F_supported) {
+                    node = ReadFilter(scanner, log, context);
+                }
+                else if (options.mode == HIE_CompilerOptions::MODE_STRICT) {
+                    HIE_Error error(HIE_UNEXPECTEDCHARACTER, current,
+                                    scanner.GetPosition());
+                    log->Push(error);
+                    log->SetFatal();
+                }
+
+                if (log->IsFatal()) {
+                    if (node) context.Discard(node);
+                    node = NULL;
+                    break;
+                }
+                if (node) node->SetPosition(position);
+                state = HIE_PARSE_POSTFIX;
+                break;
+            }
+
+            case HIE_PARSE_GROUP:
+                // Read the nodes for the group.
+                if (!scanner.End() && scanner.Chr() != options.instr_Gclose)
+                    state = HIE_PARSE_NODE;
+                else
+                    state = HIE_PARSE_CLOSE;
+                break;
+
+            case HIE_PARSE_CLOSE: {
+                HIE_ParseFrame* frame = context.GetFrame();
+                HIE_Container* container = (HIE_Container*) frame->node;
+                LONG base = frame->base;
+                context.PopFrame();
+
+                if (!context.Finish(container, base)) {
+                    log->SetFatal();
+                }
+
+                // If there was not already a fatal error, check if there
+                // should be one.
+                if (!log->IsFatal()) {
+                    if (scanner.End()) {
+                        HIE_Error error(HIE_EOI);
+                        log->Push(error);
+                        log->SetFatal();
+                    }
+                    else if (scanner.Chr() != options.instr_Gclose) {
+                        HIE_Error error(HIE_UNEXPECTEDCHARACTER, scanner.Chr(),
+                                        scanner.GetPosition());
+                        log->Push(error);
+                        log->SetFatal();
+                    }
+                }
+
+                node = container;
+                if (log->IsFatal()) {
+                    context.Discard(node);
+                    node = NULL;
+                    state = HIE_PARSE_DONE;
+                }
+                else {
+                    state = HIE_PARSE_POSTFIX;
+                }
+                break;
+            }
+
+            case HIE_PARSE_POSTFIX:
+                state = HIE_PARSE_DONE;
+                scanner.Read();
+                if (scanner.End()) break;
+
+                // Check for the * and + operators.
+                current = scanner.Chr();
+                while (current == options.instr_Star || current == options.instr_Plus) {
+                    if (node) {
+                        LONG minimum = current == options.instr_Plus ? 1 : 0;
+                        HIE_BaseNode* repeat = context.NewRepeat(node, minimum);
+                        if (!repeat) {
+                            context.Discard(node);
+                            node = NULL;
+                            log->SetFatal();
+                            break;
+                        }
+                        repeat->SetPosition(scanner.GetPosition());
+                        node = repeat;
+                    }
+                    scanner.Read();
+                    if (scanner.End()) break;
+                    current = scanner.Chr();
+                }
+                if (log->IsFatal() || scanner.End()) break;
+
+                // Check for the | operator, its right-hand node is read
+                // next.
+                if (current == options.instr_Or) {
+                    position = scanner.GetPosition();
+                    scanner.Read();
+                    if (!context.PushFrame(HIE_ParseFrame::FRAME_OR, node, position)) {
+                        if (node) context.Discard(node);
+                        node = NULL;
+                        log->SetFatal();
+                        break;
+                    }
+                    state = HIE_PARSE_NODE;
+                }
+                break;
+
+            case HIE_PARSE_DONE: {
+                HIE_ParseFrame* frame = context.GetFrame();
+                if (!frame) return node;
+
+                if (frame->type == HIE_ParseFrame::FRAME_GROUP) {
+                    // A group ends at the first node that could not be
+                    // read.
+                    if (!node) {
+                        state = HIE_PARSE_CLOSE;
+                    }
+                    else if (!context.Push(node)) {
+                        log->SetFatal();
+                        state = HIE_PARSE_CLOSE;
+                    }
+                    else {
+                        state = HIE_PARSE_GROUP;
+                    }
+                    break;
+                }
+
+                HIE_BaseNode* left = frame->node;
+                position = frame->base;
+                context.PopFrame();
+                if (!node) {
+                    LONG position = scanner.GetPosition();
+                    HIE_Error error(HIE_EXPECTEDINSTRUCTION, position);
+                    log->Push(error);
+                    log->SetFatal();
+                    if (left) context.Discard(left);
+                    break;
+                }
+
+                // In loose mode the left-hand node may have been skipped.
+                if (!left) break;
+
+                HIE_BaseNode* orNode = context.NewOr(left, node);
+                if (!orNode) {
+                    context.Discard(left);
+                    context.Discard(node);
+                    log->SetFatal();
+                    node = NULL;
+                    break;
+                }
+                orNode->SetPosition(position);
+                node = orNode;
+                break;
+            }
+        }
+    }
+}
+
+HIE_Container* HIE_CompileExpression(const String& input, HIE_Error* error,
             HIE_CompilerOptions* options) {
     HIE_Compiler compiler;
     if (options) compiler.options = *options;
@@ -0,0 +1,237 @@
+/**
+ * Simplified BSD License
+ * Copyright (C) 2013, Niklas Rosenstein. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * official policies, either expressed or implied, of the copyright
+ * holders.
+ *
+ * ***********************************************************************
+ *
+ * HIE_Bulk.h implementation.
+ */
+
+#include "HIE_Bulk.h"
+#include "HIE_Parallel.h"
+
+/**
+ * @return TRUE for the whitespace that is trimmed from lines.
+ */
+static inline Bool HIE_IsBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+/**
+ * Compiles a range of entries, each into its own slice of the block.
+ */
+class HIE_BulkJob : public HIE_ParallelJob {
+
+    const HIE_Compiler* compiler;
+    HIE_SetEntry* entries;
+    char* block;
+    const String* strings;
+
+    public:
+
+    HIE_BulkJob(const HIE_Compiler* compiler, HIE_SetEntry* entries,
+                char* block, const String* strings)
+    : compiler(compiler), entries(entries), block(block), strings(strings) {}
+
+    /* Override: HIE_ParallelJob */
+    void Run(LONG begin, LONG end) {
+        for (; begin < end; begin++) {
+            HIE_SetEntry& entry = entries[begin];
+            HIE_Arena arena;
+            arena.Init(block + entry.offset, entry.size);
+
+            HIE_ErrorLog log;
+            if (strings) {
+                char* text = strings[begin].GetCStringCopy(STRINGENCODING_UTF8);
+                if (text) {
+                    entry.root = compiler->Compile(text, -1, &log, &arena);
+                    GeFree(text);
+                }
+            }
+            else {
+                entry.root = compiler->Compile(entry.text, entry.length, &log, &arena);
+            }
+
+            if (log.HasError()) {
+                entry.error = log.GetLast();
+                entry.hasError = TRUE;
+            }
+        }
+    }
+
+};
+
+Bool HIE_ExpressionSet::CompileText(const char* text, LONG length,
+            const HIE_CompilerOptions* options, LONG threads,
+            BaseThread* parent) {
+    Free();
+    if (length < 0) length = text ? strlen(text) : 0;
+
+    // Count the lines to size the entry list.
+    LONG lines = 1;
+    LONG index = 0;
+    for (; index < length; index++) {
+        if (text[index] == '\n') lines++;
+    }
+
+    entries = (HIE_SetEntry*) GeAlloc(sizeof(HIE_SetEntry) * lines);
+    if (!entries) return FALSE;
+
+    LONG line = 1;
+    LONG begin = 0;
+    while (begin <= length) {
+        LONG end = begin;
+        while (end < length && text[end] != '\n') end++;
+
+        LONG first = begin;
+        LONG last = end;
+        while (first < last && HIE_IsBlank(text[first])) first++;
+        while (last > first && HIE_IsBlank(text[last - 1])) last--;
+
+        if (first < last && text[first] != '#') {
+            HIE_SetEntry& entry = entries[count++];
+            entry.error = HIE_Error();
+            entry.text = text + first;
+            entry.length = last - first;
+            entry.line = line;
+            entry.root = NULL;
+            entry.hasError = FALSE;
+        }
+
+        begin = end + 1;
+        line++;
+    }
+
+    return Compile(NULL, options, threads, parent);
+}
+
+Bool HIE_ExpressionSet::CompileStrings(const String* strings, LONG count,
+            const HIE_CompilerOptions* options, LONG threads,
+            BaseThread* parent) {
+    Free();
+    if (count <= 0) return TRUE;
+
+    entries = (HIE_SetEntry*) GeAlloc(sizeof(HIE_SetEntry) * count);
+    if (!entries) return FALSE;
+
+    LONG index = 0;
+    for (; index < count; index++) {
+        HIE_SetEntry& entry = entries[index];
+        entry.error = HIE_Error();
+        entry.text = NULL;
+        entry.length = strings[index].GetLength();
+        entry.line = index;
+        entry.root = NULL;
+        entry.hasError = FALSE;
+    }
+    this->count = count;
+
+    return Compile(strings, options, threads, parent);
+}
+
+Bool HIE_ExpressionSet::CompileFile(const Filename& filename,
+            const HIE_CompilerOptions* options, LONG threads,
+            BaseThread* parent) {
+    Free();
+
+    AutoAlloc<BaseFile> file;
+    if (!file) return FALSE;
+    if (!file->Open(filename, FILEOPEN_READ, FILEDIALOG_NONE)) return FALSE;
+
+    LLONG length = file->GetLength();
+    if (length < 0 || length > 0x7fffffff) return FALSE;
+
+    char* text = (char*) GeAlloc((LONG) length + 1);
+    if (!text) return FALSE;
+
+    Bool success = file->ReadBytes(text, (LONG) length) == (LONG) length;
+    file->Close();
+
+    if (success) {
+        success = CompileText(text, (LONG) length, options, threads, parent);
+    }
+    GeFree(text);
+    return success;
+}
+
+Bool HIE_ExpressionSet::Compile(const String* strings,
+            const HIE_CompilerOptions* options, LONG threads,
+            BaseThread* parent) {
+    // Every entry gets a slice of the block that is large enough for
+    // any expression of its length.
+    LONG total = 0;
+    LONG index = 0;
+    for (; index < count; index++) {
+        HIE_SetEntry& entry = entries[index];
+        LONG size = HIE_Compiler::GetArenaSize(entry.length);
+        if (size < 0 || size > 0x7fffffff - HIE_Arena::ALIGNMENT - total) {
+            Free();
+            return FALSE;
+        }
+        size = (size + HIE_Arena::ALIGNMENT - 1) & ~(HIE_Arena::ALIGNMENT - 1);
+        entry.offset = total;
+        entry.size = size;
+        total += size;
+    }
+
+    char* block = NULL;
+    if (total > 0) {
+        if (arena.Init(total)) block = (char*) arena.Alloc(total);
+        if (!block) {
+            Free();
+            return FALSE;
+        }
+    }
+
+    HIE_Compiler compiler;
+    if (options) compiler.options = *options;
+
+    HIE_BulkJob job(&compiler, entries, block, strings);
+    Bool success = HIE_RunParallel(&job, count, CHUNK, threads, parent);
+
+    errors = 0;
+    for (index = 0; index < count; index++) {
+        entries[index].text = NULL;
+        if (entries[index].hasError) errors++;
+    }
+    return success;
+}
+
+void HIE_ExpressionSet::Free() {
+    // The compiled expressions live in the arena and are never
+    // destructed individually.
+    if (entries) GeFree(entries);
+    entries = NULL;
+    count = 0;
+    errors = 0;
+    arena.Free();
+}
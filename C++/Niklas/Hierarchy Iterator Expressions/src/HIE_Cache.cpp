@@ -0,0 +1,258 @@
+/**
+ * Simplified BSD License
+ * Copyright (C) 2013, Niklas Rosenstein. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * official policies, either expressed or implied, of the copyright
+ * holders.
+ *
+ * ***********************************************************************
+ *
+ * HIE_Cache.h implementation.
+ */
+
+#include "HIE_Cache.h"
+
+struct HIE_CacheEntry {
+
+    /**
+     * The expression text, owned by the entry.
+     */
+    char* text;
+
+    /**
+     * The length of the expression text.
+     */
+    LONG length;
+
+    /**
+     * The hash of the text and the options.
+     */
+    ULONG hash;
+
+    /**
+     * The options the expression was compiled with.
+     */
+    HIE_CompilerOptions options;
+
+    /**
+     * The compiled expression. The entry holds one reference.
+     */
+    HIE_Expression* expression;
+
+    /**
+     * The next entry in the same hash table chain.
+     */
+    HIE_CacheEntry* chain;
+
+    /**
+     * The more recently used neighbour in the LRU list.
+     */
+    HIE_CacheEntry* prev;
+
+    /**
+     * The less recently used neighbour in the LRU list.
+     */
+    HIE_CacheEntry* next;
+
+    HIE_CacheEntry() : text(NULL), length(0), hash(0), expression(NULL),
+                       chain(NULL), prev(NULL), next(NULL) {}
+
+    void* operator new (size_t size) {
+        return GeAlloc(size);
+    }
+
+    void operator delete (void* p) {
+        GeFree(p);
+    }
+
+};
+
+/**
+ * Hashes expression text, seeded with the options fingerprint.
+ */
+static ULONG HIE_HashText(const char* text, LONG length, ULONG seed) {
+    ULONG hash = seed;
+    LONG index = 0;
+    for (; index < length; index++) {
+        hash = (hash ^ (UCHAR) text[index]) * 16777619u;
+    }
+    return hash;
+}
+
+HIE_ExpressionCache::HIE_ExpressionCache(LONG capacity)
+: buckets(NULL), bucketCount(16), head(NULL), tail(NULL), count(0),
+  capacity(capacity), hits(0), misses(0) {
+    if (this->capacity < 1) this->capacity = 1;
+    while (bucketCount < this->capacity * 2) bucketCount *= 2;
+
+    buckets = (HIE_CacheEntry**) GeAlloc(sizeof(HIE_CacheEntry*) * bucketCount);
+    if (buckets) {
+        LONG index = 0;
+        for (; index < bucketCount; index++)
+            buckets[index] = NULL;
+    }
+}
+
+HIE_ExpressionCache::~HIE_ExpressionCache() {
+    Flush();
+    if (buckets) {
+        GeFree(buckets);
+        buckets = NULL;
+    }
+}
+
+HIE_Expression* HIE_ExpressionCache::Get(const String& input,
+            HIE_Error* error, const HIE_CompilerOptions* options) {
+    HIE_CompilerOptions defaults;
+    if (!options) options = &defaults;
+
+    char* text = input.GetCStringCopy();
+    if (!text) return NULL;
+    LONG length = input.GetLength();
+    ULONG hash = HIE_HashText(text, length, options->GetFingerprint());
+
+    lock.Lock();
+    HIE_CacheEntry* entry = Find(text, length, hash, *options);
+    if (entry) {
+        HIE_Expression* expression = entry->expression;
+        expression->AddRef();
+        Touch(entry);
+        hits++;
+        lock.Unlock();
+        GeFree(text);
+        return expression;
+    }
+    misses++;
+    lock.Unlock();
+
+    // Compile without holding the lock so other threads are not
+    // blocked by it.
+    HIE_Compiler compiler(*options);
+    HIE_ErrorLog log;
+    HIE_Expression* expression = compiler.CompileExpression(input, &log);
+    if (log.HasError() && error) {
+        *error = log.GetLast();
+    }
+    if (!expression) {
+        GeFree(text);
+        return NULL;
+    }
+
+    lock.Lock();
+    entry = Find(text, length, hash, *options);
+    if (entry) {
+        // Another thread compiled the same expression in the meantime.
+        expression->Release();
+        expression = entry->expression;
+        expression->AddRef();
+        Touch(entry);
+    }
+    else if (buckets) {
+        entry = new HIE_CacheEntry;
+        if (entry) {
+            entry->text = text;
+            entry->length = length;
+            entry->hash = hash;
+            entry->options = *options;
+            entry->expression = expression;
+            expression->AddRef();
+
+            HIE_CacheEntry** bucket = &buckets[hash & (bucketCount - 1)];
+            entry->chain = *bucket;
+            *bucket = entry;
+            count++;
+            text = NULL;
+
+            Touch(entry);
+            while (count > capacity) {
+                Remove(tail);
+            }
+        }
+    }
+    lock.Unlock();
+
+    if (text) GeFree(text);
+    return expression;
+}
+
+void HIE_ExpressionCache::Flush() {
+    lock.Lock();
+    while (head) {
+        Remove(head);
+    }
+    lock.Unlock();
+}
+
+HIE_CacheEntry* HIE_ExpressionCache::Find(const char* text, LONG length,
+            ULONG hash, const HIE_CompilerOptions& options) const {
+    if (!buckets) return NULL;
+
+    HIE_CacheEntry* entry = buckets[hash & (bucketCount - 1)];
+    for (; entry; entry = entry->chain) {
+        if (entry->hash == hash && entry->length == length &&
+            memcmp(entry->text, text, length) == 0 &&
+            entry->options.IsEqual(options)) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+void HIE_ExpressionCache::Remove(HIE_CacheEntry* entry) {
+    HIE_CacheEntry** link = &buckets[entry->hash & (bucketCount - 1)];
+    while (*link != entry) {
+        link = &(*link)->chain;
+    }
+    *link = entry->chain;
+
+    if (entry->prev) entry->prev->next = entry->next;
+    else head = entry->next;
+    if (entry->next) entry->next->prev = entry->prev;
+    else tail = entry->prev;
+
+    entry->expression->Release();
+    GeFree(entry->text);
+    delete entry;
+    count--;
+}
+
+void HIE_ExpressionCache::Touch(HIE_CacheEntry* entry) {
+    if (head == entry) return;
+
+    // Unlink the entry if it is already in the list.
+    if (entry->prev) entry->prev->next = entry->next;
+    if (entry->next) entry->next->prev = entry->prev;
+    else if (tail == entry) tail = entry->prev;
+
+    entry->prev = NULL;
+    entry->next = head;
+    if (head) head->prev = entry;
+    head = entry;
+    if (!tail) tail = entry;
+}
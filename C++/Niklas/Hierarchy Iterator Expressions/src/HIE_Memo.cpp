@@ -0,0 +1,258 @@
+/**
+ * Simplified BSD License
+ * Copyright (C) 2013, Niklas Rosenstein. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * official policies, either expressed or implied, of the copyright
+ * holders.
+ *
+ * ***********************************************************************
+ *
+ * HIE_Memo.h implementation.
+ */
+
+#include "HIE_Memo.h"
+
+/**
+ * Hashes a node address.
+ */
+static inline ULONG HIE_HashPointer(const void* p) {
+    VULONG value = (VULONG) p;
+    value ^= value >> 16;
+    value *= 0x45d9f3b;
+    value ^= value >> 16;
+    return (ULONG) value;
+}
+
+/**
+ * Checks if the results of an expression may be remembered. Nodes
+ * reached through a generator cache may be freed when the generator
+ * rebuilds its cache, which does not change the hierarchy stamp.
+ * Neither do selection changes and renames, which the bit and name
+ * filters depend on. Only node types known to be free of such
+ * dependencies are accepted.
+ */
+static Bool HIE_IsMemoizable(const HIE_BaseNode* node) {
+    if (!node) return TRUE;
+    switch (node->GetType()) {
+        case HIE_NODE_CACHE:
+            return FALSE;
+        case HIE_NODE_STEP:
+            return ((const HIE_StepNode*) node)->GetInstruction() != HIE_NODE_CACHE;
+        case HIE_NODE_FILTER: {
+            LONG filter = ((const HIE_FilterNode*) node)->GetFilter();
+            return filter != HIE_FilterNode::FILTER_NAME &&
+                   filter != HIE_FilterNode::FILTER_BIT;
+        }
+        case HIE_NODE_OR: {
+            const HIE_OrOperatorNode* op = (const HIE_OrOperatorNode*) node;
+            return HIE_IsMemoizable(op->GetLeft()) && HIE_IsMemoizable(op->GetRight());
+        }
+        case HIE_NODE_REPEAT:
+            return HIE_IsMemoizable(((const HIE_RepeatNode*) node)->GetNode());
+        case HIE_NODE_CONTAINER: {
+            const HIE_Container* container = (const HIE_Container*) node;
+            LONG count = container->GetCount();
+            LONG index = 0;
+            for (; index < count; index++) {
+                if (!HIE_IsMemoizable(container->GetNode(index))) return FALSE;
+            }
+            return TRUE;
+        }
+        case HIE_NODE_NEXT:
+        case HIE_NODE_PRED:
+        case HIE_NODE_UP:
+        case HIE_NODE_DOWN:
+            return TRUE;
+        default:
+            // Unknown nodes, e.g. HIE_StaticNode or custom subclasses,
+            // may read anything.
+            return FALSE;
+    }
+}
+
+HIE_MemoCache::HIE_MemoCache(const HIE_BaseNode* root)
+: root(root), slots(NULL), size(0), count(0), stamp(0), hits(0),
+  misses(0), invalidations(0), memoize(HIE_IsMemoizable(root)) {
+}
+
+HIE_MemoCache::~HIE_MemoCache() {
+    if (slots) {
+        GeFree(slots);
+        slots = NULL;
+    }
+}
+
+GeListNode* HIE_MemoCache::GetNextNode(GeListNode* node, ULONG stamp) {
+    if (!memoize) {
+        misses++;
+        return root->GetNextNode(node);
+    }
+    Validate(stamp);
+
+    Slot* slot = Find(node);
+    if (slot && slot->key) {
+        hits++;
+        return slot->value;
+    }
+
+    misses++;
+    GeListNode* dest = root->GetNextNode(node);
+    Insert(node, dest);
+    return dest;
+}
+
+void HIE_MemoCache::GetNextNodes(GeListNode* const* input,
+            GeListNode** output, LONG total, ULONG stamp) {
+    if (!memoize) {
+        LONG index = 0;
+        for (; index < total; index++) {
+            if (input[index]) misses++;
+        }
+        root->GetNextNodes(input, output, total);
+        return;
+    }
+    Validate(stamp);
+
+    LONG index = 0;
+    LONG pending = 0;
+    LONG requested = 0;
+
+    // Answer what is remembered and gather the rest at the front of
+    // a scratch array.
+    GeListNode** scratch = (GeListNode**) GeAlloc(sizeof(GeListNode*) * total * 2);
+    if (!scratch) {
+        for (; index < total; index++) {
+            GeListNode* node = input[index];
+            output[index] = node ? GetNextNode(node, stamp) : NULL;
+        }
+        return;
+    }
+    GeListNode** results = scratch + total;
+
+    for (; index < total; index++) {
+        GeListNode* node = input[index];
+        if (!node) continue;
+        requested++;
+        Slot* slot = Find(node);
+        if (!(slot && slot->key)) {
+            scratch[pending++] = node;
+        }
+    }
+
+    misses += pending;
+    root->GetNextNodes(scratch, results, pending);
+    for (index = 0; index < pending; index++) {
+        Insert(scratch[index], results[index]);
+    }
+
+    for (index = 0; index < total; index++) {
+        GeListNode* node = input[index];
+        Slot* slot = node ? Find(node) : NULL;
+        if (slot && slot->key) {
+            output[index] = slot->value;
+        }
+        else if (node) {
+            // Not remembered because the table could not grow.
+            output[index] = root->GetNextNode(node);
+        }
+        else {
+            output[index] = NULL;
+        }
+    }
+    hits += requested - pending;
+
+    GeFree(scratch);
+}
+
+void HIE_MemoCache::Invalidate() {
+    if (count > 0) {
+        LONG index = 0;
+        for (; index < size; index++) {
+            slots[index].key = NULL;
+            slots[index].value = NULL;
+        }
+        count = 0;
+    }
+    invalidations++;
+}
+
+void HIE_MemoCache::Validate(ULONG stamp) {
+    if (stamp != this->stamp) {
+        Invalidate();
+        this->stamp = stamp;
+    }
+}
+
+HIE_MemoCache::Slot* HIE_MemoCache::Find(GeListNode* key) const {
+    if (!slots) return NULL;
+
+    LONG mask = size - 1;
+    LONG index = HIE_HashPointer(key) & mask;
+    while (slots[index].key && slots[index].key != key) {
+        index = (index + 1) & mask;
+    }
+    return &slots[index];
+}
+
+void HIE_MemoCache::Insert(GeListNode* key, GeListNode* value) {
+    // Keep the table at most half full.
+    if ((count + 1) * 2 > size && !Grow()) return;
+
+    Slot* slot = Find(key);
+    if (!slot->key) {
+        slot->key = key;
+        count++;
+    }
+    slot->value = value;
+}
+
+Bool HIE_MemoCache::Grow() {
+    LONG newSize = size ? size * 2 : INITIAL_SIZE;
+    Slot* newSlots = (Slot*) GeAlloc(sizeof(Slot) * newSize);
+    if (!newSlots) return FALSE;
+
+    LONG index = 0;
+    for (; index < newSize; index++) {
+        newSlots[index].key = NULL;
+        newSlots[index].value = NULL;
+    }
+
+    Slot* oldSlots = slots;
+    LONG oldSize = size;
+    slots = newSlots;
+    size = newSize;
+    count = 0;
+
+    for (index = 0; index < oldSize; index++) {
+        if (oldSlots[index].key)
+            Insert(oldSlots[index].key, oldSlots[index].value);
+    }
+    if (oldSlots) GeFree(oldSlots);
+    return TRUE;
+}
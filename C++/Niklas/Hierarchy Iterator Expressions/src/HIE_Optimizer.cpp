@@ -0,0 +1,440 @@
+/**
+ * Simplified BSD License
+ * Copyright (C) 2013, Niklas Rosenstein. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * official policies, either expressed or implied, of the copyright
+ * holders.
+ *
+ * ***********************************************************************
+ *
+ * HIE_Optimizer.h implementation.
+ */
+
+#include "HIE_Optimizer.h"
+
+/**
+ * Helper for HIE_Optimize(), rewrites a node tree bottom-up.
+ */
+class HIE_Optimizer {
+
+    public:
+
+    /**
+     * The arena of the tree, or NULL.
+     */
+    HIE_Arena* arena;
+
+    /**
+     * Receives the statistics. Not NULL.
+     */
+    HIE_OptimizerStats* stats;
+
+    HIE_Optimizer(HIE_Arena* arena, HIE_OptimizerStats* stats)
+    : arena(arena), stats(stats) {}
+
+    /**
+     * Deallocate a node that is no longer part of the tree. Nodes in
+     * an arena are freed with the arena.
+     */
+    void Discard(HIE_BaseNode* node) {
+        if (!arena) delete node;
+    }
+
+    /**
+     * Allocate a counted step.
+     */
+    HIE_StepNode* NewStep(LONG instruction, LONG count) {
+        if (arena) return new (arena) HIE_StepNode(instruction, count);
+        return new HIE_StepNode(instruction, count);
+    }
+
+    /**
+     * Determine the instruction and count of a node that can be
+     * merged into a counted step.
+     * @return TRUE if the node is a step, FALSE if not.
+     */
+    static Bool GetStep(const HIE_BaseNode* node, LONG* instruction, LONG* count) {
+        LONG type = node->GetType();
+        switch (type) {
+            case HIE_NODE_NEXT:
+            case HIE_NODE_PRED:
+            case HIE_NODE_UP:
+            case HIE_NODE_DOWN:
+            case HIE_NODE_CACHE:
+                *instruction = type;
+                *count = 1;
+                return TRUE;
+            case HIE_NODE_STEP:
+                *instruction = ((const HIE_StepNode*) node)->GetInstruction();
+                *count = ((const HIE_StepNode*) node)->GetCount();
+                return TRUE;
+            default:
+                return FALSE;
+        }
+    }
+
+    /**
+     * Optimize a node and its children.
+     * @return The node replacing `node`. `node` has been deallocated
+     * if it differs.
+     */
+    HIE_BaseNode* Optimize(HIE_BaseNode* node) {
+        switch (node->GetType()) {
+            case HIE_NODE_OR:
+                return OptimizeOr((HIE_OrOperatorNode*) node);
+            case HIE_NODE_REPEAT: {
+                HIE_RepeatNode* repeat = (HIE_RepeatNode*) node;
+                repeat->SetNode(Optimize(repeat->GetNode()));
+                return repeat;
+            }
+            case HIE_NODE_CONTAINER:
+                return OptimizeContainer((HIE_Container*) node, FALSE);
+            default:
+                return node;
+        }
+    }
+
+    /**
+     * Optimize an OR operator. The right-hand node is dead if the
+     * left-hand node never fails or is equal to it.
+     */
+    HIE_BaseNode* OptimizeOr(HIE_OrOperatorNode* op) {
+        HIE_BaseNode* left = Optimize(op->GetLeft());
+        HIE_BaseNode* right = Optimize(op->GetRight());
+        if (HIE_NeverFails(left) || HIE_IsEqualTree(left, right)) {
+            op->SetOperands(NULL, NULL);
+            Discard(right);
+            Discard(op);
+            stats->removed++;
+            return left;
+        }
+        op->SetOperands(left, right);
+        return op;
+    }
+
+    /**
+     * Optimize a container. The root container is never replaced.
+     */
+    HIE_BaseNode* OptimizeContainer(HIE_Container* container, Bool root) {
+        LONG mode = container->mode;
+        if (mode != HIE_Container::MODE_CONSECUTIVE &&
+            mode != HIE_Container::MODE_ACCUMULATE &&
+            mode != HIE_Container::MODE_FIRST) {
+            return container;
+        }
+
+        LONG count = container->GetCount();
+        if (count <= 0) return container;
+
+        HIE_BaseNode** children = (HIE_BaseNode**) GeAlloc(sizeof(HIE_BaseNode*) * count);
+        if (!children) return container;
+
+        // Optimize the children first and count the nodes of the
+        // groups that will be spliced into this container.
+        LONG index = 0;
+        LONG total = 0;
+        for (; index < count; index++) {
+            HIE_BaseNode* child = Optimize(container->GetNode(index));
+            children[index] = child;
+            total += IsSpliced(child, mode) ? ((HIE_Container*) child)->GetCount() : 1;
+        }
+
+        // The rewritten nodes, the nodes dropped from the container and
+        // the new counted steps.
+        HIE_BaseNode** list = (HIE_BaseNode**) GeAlloc(sizeof(HIE_BaseNode*) * (3 * total + 1));
+        if (!list) {
+            container->Replace(children, count, arena);
+            GeFree(children);
+            return container;
+        }
+        HIE_BaseNode** dropped = list + total;
+        HIE_BaseNode** created = dropped + total;
+        LONG size = 0;
+        LONG droppedCount = 0;
+        LONG createdCount = 0;
+        LONG flattened = 0;
+        LONG collapsed = 0;
+        LONG removed = 0;
+
+        for (index = 0; index < count; index++) {
+            HIE_BaseNode* child = children[index];
+            if (IsSpliced(child, mode)) {
+                HIE_Container* group = (HIE_Container*) child;
+                LONG length = group->GetCount();
+                LONG sub = 0;
+                for (; sub < length; sub++) list[size++] = group->GetNode(sub);
+                flattened++;
+            }
+            else {
+                list[size++] = child;
+            }
+        }
+
+        // Merge runs of the same instruction into counted steps.
+        if (mode == HIE_Container::MODE_CONSECUTIVE) {
+            LONG write = 0;
+            LONG read = 0;
+            while (read < size) {
+                LONG instruction, steps;
+                if (!GetStep(list[read], &instruction, &steps)) {
+                    list[write++] = list[read++];
+                    continue;
+                }
+
+                LONG end = read + 1;
+                LONG other, otherSteps;
+                while (end < size && GetStep(list[end], &other, &otherSteps) &&
+                       other == instruction) {
+                    steps += otherSteps;
+                    end++;
+                }
+
+                HIE_StepNode* step = NULL;
+                if (end - read > 1) step = NewStep(instruction, steps);
+                if (!step) {
+                    for (; read < end; read++) list[write++] = list[read];
+                    continue;
+                }
+                step->SetPosition(list[read]->GetPosition());
+
+                // The merged nodes are released only once the
+                // container was rewritten successfully.
+                created[createdCount++] = step;
+                collapsed += end - read;
+                for (; read < end; read++) dropped[droppedCount++] = list[read];
+                list[write++] = step;
+            }
+            size = write;
+        }
+
+        // Remove alternatives that are never reached.
+        if (mode == HIE_Container::MODE_FIRST) {
+            LONG write = 0;
+            LONG read = 0;
+            Bool dead = FALSE;
+            for (; read < size; read++) {
+                HIE_BaseNode* child = list[read];
+                Bool duplicate = FALSE;
+                LONG prev = 0;
+                for (; prev < write && !duplicate; prev++) {
+                    duplicate = HIE_IsEqualTree(list[prev], child);
+                }
+                if (dead || duplicate) {
+                    dropped[droppedCount++] = child;
+                    removed++;
+                    continue;
+                }
+                list[write++] = child;
+                if (HIE_NeverFails(child)) dead = TRUE;
+            }
+            size = write;
+        }
+
+        if (!container->Replace(list, size, arena)) {
+            // Undo the rewrite, the children are still intact.
+            container->Replace(children, count, arena);
+            for (index = 0; index < createdCount; index++) Discard(created[index]);
+            GeFree(list);
+            GeFree(children);
+            return container;
+        }
+
+        // Release the groups that were spliced and the nodes that were
+        // dropped.
+        for (index = 0; index < count; index++) {
+            if (IsSpliced(children[index], mode)) {
+                HIE_Container* group = (HIE_Container*) children[index];
+                group->Replace(NULL, 0, arena);
+                Discard(group);
+            }
+        }
+        for (index = 0; index < droppedCount; index++) Discard(dropped[index]);
+
+        GeFree(list);
+        GeFree(children);
+
+        stats->flattened += flattened;
+        stats->collapsed += collapsed;
+        stats->removed += removed;
+
+        // A consecutive or first group with a single node is the node
+        // itself.
+        if (!root && size == 1 && mode != HIE_Container::MODE_ACCUMULATE) {
+            HIE_BaseNode* node = container->GetNode(0);
+            container->Replace(NULL, 0, arena);
+            Discard(container);
+            stats->flattened++;
+            return node;
+        }
+        return container;
+    }
+
+    /**
+     * @return TRUE if `node` is a group whose nodes can be moved into
+     * a container of the passed mode.
+     */
+    static Bool IsSpliced(const HIE_BaseNode* node, LONG mode) {
+        if (node->GetType() != HIE_NODE_CONTAINER) return FALSE;
+        const HIE_Container* group = (const HIE_Container*) node;
+        if (group->mode == mode) return TRUE;
+
+        // An empty consecutive or accumulative group returns the node
+        // it was passed and has no effect in either of these modes.
+        return group->GetCount() == 0 && mode != HIE_Container::MODE_FIRST &&
+               (group->mode == HIE_Container::MODE_CONSECUTIVE ||
+                group->mode == HIE_Container::MODE_ACCUMULATE);
+    }
+
+};
+
+void HIE_Optimize(HIE_Container* root, HIE_Arena* arena,
+            HIE_OptimizerStats* stats) {
+    HIE_OptimizerStats local;
+    if (!stats) stats = &local;
+
+    stats->before = HIE_CountNodes(root);
+    HIE_Optimizer optimizer(arena, stats);
+    optimizer.OptimizeContainer(root, TRUE);
+    stats->after = HIE_CountNodes(root);
+}
+
+LONG HIE_CountNodes(const HIE_BaseNode* node) {
+    if (!node) return 0;
+    switch (node->GetType()) {
+        case HIE_NODE_OR: {
+            const HIE_OrOperatorNode* op = (const HIE_OrOperatorNode*) node;
+            return 1 + HIE_CountNodes(op->GetLeft()) + HIE_CountNodes(op->GetRight());
+        }
+        case HIE_NODE_REPEAT:
+            return 1 + HIE_CountNodes(((const HIE_RepeatNode*) node)->GetNode());
+        case HIE_NODE_CONTAINER: {
+            const HIE_Container* container = (const HIE_Container*) node;
+            LONG count = container->GetCount();
+            LONG index = 0;
+            LONG total = 1;
+            for (; index < count; index++) {
+                total += HIE_CountNodes(container->GetNode(index));
+            }
+            return total;
+        }
+        default:
+            return 1;
+    }
+}
+
+Bool HIE_IsEqualTree(const HIE_BaseNode* a, const HIE_BaseNode* b) {
+    if (a == b) return TRUE;
+    if (!a || !b) return FALSE;
+
+    LONG type = a->GetType();
+    if (type != b->GetType()) return FALSE;
+
+    switch (type) {
+        case HIE_NODE_NEXT:
+        case HIE_NODE_PRED:
+        case HIE_NODE_UP:
+        case HIE_NODE_DOWN:
+        case HIE_NODE_CACHE:
+            return TRUE;
+        case HIE_NODE_STEP: {
+            const HIE_StepNode* x = (const HIE_StepNode*) a;
+            const HIE_StepNode* y = (const HIE_StepNode*) b;
+            return x->GetInstruction() == y->GetInstruction() &&
+                   x->GetCount() == y->GetCount();
+        }
+        case HIE_NODE_FILTER: {
+            const HIE_FilterNode* x = (const HIE_FilterNode*) a;
+            const HIE_FilterNode* y = (const HIE_FilterNode*) b;
+            return x->GetFilter() == y->GetFilter() &&
+                   x->GetValue() == y->GetValue() &&
+                   x->IsNegated() == y->IsNegated();
+        }
+        case HIE_NODE_OR: {
+            const HIE_OrOperatorNode* x = (const HIE_OrOperatorNode*) a;
+            const HIE_OrOperatorNode* y = (const HIE_OrOperatorNode*) b;
+            return HIE_IsEqualTree(x->GetLeft(), y->GetLeft()) &&
+                   HIE_IsEqualTree(x->GetRight(), y->GetRight());
+        }
+        case HIE_NODE_REPEAT: {
+            const HIE_RepeatNode* x = (const HIE_RepeatNode*) a;
+            const HIE_RepeatNode* y = (const HIE_RepeatNode*) b;
+            return x->GetMinimum() == y->GetMinimum() &&
+                   HIE_IsEqualTree(x->GetNode(), y->GetNode());
+        }
+        case HIE_NODE_CONTAINER: {
+            const HIE_Container* x = (const HIE_Container*) a;
+            const HIE_Container* y = (const HIE_Container*) b;
+            LONG count = x->GetCount();
+            LONG index = 0;
+            if (x->mode != y->mode || count != y->GetCount()) return FALSE;
+            for (; index < count; index++) {
+                if (!HIE_IsEqualTree(x->GetNode(index), y->GetNode(index)))
+                    return FALSE;
+            }
+            return TRUE;
+        }
+        default:
+            // Unknown nodes may carry state that is not visible here.
+            return FALSE;
+    }
+}
+
+Bool HIE_NeverFails(const HIE_BaseNode* node) {
+    switch (node->GetType()) {
+        case HIE_NODE_OR: {
+            const HIE_OrOperatorNode* op = (const HIE_OrOperatorNode*) node;
+            return HIE_NeverFails(op->GetLeft()) || HIE_NeverFails(op->GetRight());
+        }
+        case HIE_NODE_REPEAT:
+            return ((const HIE_RepeatNode*) node)->GetMinimum() <= 0;
+        case HIE_NODE_CONTAINER: {
+            const HIE_Container* container = (const HIE_Container*) node;
+            LONG count = container->GetCount();
+            LONG index = 0;
+            switch (container->mode) {
+                case HIE_Container::MODE_CONSECUTIVE:
+                    for (; index < count; index++) {
+                        if (!HIE_NeverFails(container->GetNode(index))) return FALSE;
+                    }
+                    return TRUE;
+                case HIE_Container::MODE_ACCUMULATE:
+                    return TRUE;
+                case HIE_Container::MODE_FIRST:
+                    for (; index < count; index++) {
+                        if (HIE_NeverFails(container->GetNode(index))) return TRUE;
+                    }
+                    return FALSE;
+                default:
+                    return FALSE;
+            }
+        }
+        default:
+            return FALSE;
+    }
+}
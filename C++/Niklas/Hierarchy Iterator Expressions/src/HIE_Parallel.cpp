@@ -0,0 +1,194 @@
+/**
+ * Simplified BSD License
+ * Copyright (C) 2013, Niklas Rosenstein. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * official policies, either expressed or implied, of the copyright
+ * holders.
+ *
+ * ***********************************************************************
+ *
+ * HIE_Parallel.h implementation.
+ */
+
+#include "HIE_Parallel.h"
+
+/**
+ * Hands out chunks of entries to the worker threads.
+ */
+class HIE_Scheduler {
+
+    /**
+     * Guards `next`.
+     */
+    GeSpinlock lock;
+
+    /**
+     * The first entry that was not handed out yet.
+     */
+    LONG next;
+
+    /**
+     * The number of entries.
+     */
+    LONG count;
+
+    /**
+     * The number of entries handed out at once.
+     */
+    LONG chunk;
+
+    public:
+
+    HIE_Scheduler(LONG count, LONG chunk)
+    : next(0), count(count), chunk(chunk) {}
+
+    /**
+     * Retrieves the next chunk of entries.
+     * @return FALSE when all entries were handed out.
+     */
+    Bool Fetch(LONG& begin, LONG& end) {
+        lock.Lock();
+        begin = next;
+        if (next < count) next += chunk;
+        lock.Unlock();
+
+        if (begin >= count) return FALSE;
+        end = begin + chunk;
+        if (end > count) end = count;
+        return TRUE;
+    }
+
+};
+
+/**
+ * A thread processing chunks of a HIE_ParallelJob.
+ */
+class HIE_Worker : public C4DThread {
+
+    public:
+
+    HIE_ParallelJob* job;
+    HIE_Scheduler* scheduler;
+
+    HIE_Worker() : job(NULL), scheduler(NULL) {}
+
+    /* Override: C4DThread */
+    void Main() {
+        LONG begin, end;
+        while (!TestBreak() && scheduler->Fetch(begin, end)) {
+            job->Run(begin, end);
+        }
+    }
+
+    /* Override: C4DThread */
+    const CHAR* GetThreadName() {
+        return "HIE_Worker";
+    }
+
+};
+
+/**
+ * Evaluates a range of a batch with a HIE_BaseNode or HIE_Program.
+ */
+class HIE_EvaluateJob : public HIE_ParallelJob {
+
+    const HIE_BaseNode* root;
+    const HIE_Program* program;
+    GeListNode* const* input;
+    GeListNode** output;
+
+    public:
+
+    HIE_EvaluateJob(const HIE_BaseNode* root, const HIE_Program* program,
+                    GeListNode* const* input, GeListNode** output)
+    : root(root), program(program), input(input), output(output) {}
+
+    /* Override: HIE_ParallelJob */
+    void Run(LONG begin, LONG end) {
+        if (program)
+            program->GetNextNodes(input + begin, output + begin, end - begin);
+        else
+            root->GetNextNodes(input + begin, output + begin, end - begin);
+    }
+
+};
+
+Bool HIE_RunParallel(HIE_ParallelJob* job, LONG count, LONG chunk,
+            LONG threads, BaseThread* parent) {
+    if (count <= 0) return TRUE;
+    if (chunk < 1) chunk = 1;
+    if (threads <= 0) threads = GeGetCurrentThreadCount();
+
+    // There is no point in starting more threads than chunks.
+    LONG chunks = (count - 1) / chunk + 1;
+    if (threads > chunks) threads = chunks;
+    if (threads > HIE_MAX_THREADS) threads = HIE_MAX_THREADS;
+
+    HIE_Scheduler scheduler(count, chunk);
+    LONG begin, end;
+
+    if (threads > 1) {
+        HIE_Worker workers[HIE_MAX_THREADS];
+        C4DThread* list[HIE_MAX_THREADS];
+        LONG index = 0;
+        for (; index < threads; index++) {
+            workers[index].job = job;
+            workers[index].scheduler = &scheduler;
+            list[index] = &workers[index];
+        }
+
+        MPThreadPool pool;
+        if (pool.Init(parent, threads, list) &&
+            pool.Start(THREADPRIORITY_NORMAL)) {
+            pool.Wait();
+        }
+    }
+
+    // Whatever was not handed out yet, either because no threads were
+    // started or because they stopped on a break, is processed here
+    // unless the parent asked to stop.
+    while (!(parent && parent->TestBreak()) && scheduler.Fetch(begin, end)) {
+        job->Run(begin, end);
+    }
+    return !scheduler.Fetch(begin, end);
+}
+
+Bool HIE_GetNextNodesParallel(const HIE_BaseNode* root,
+            GeListNode* const* input, GeListNode** output, LONG count,
+            LONG threads, BaseThread* parent) {
+    HIE_EvaluateJob job(root, NULL, input, output);
+    return HIE_RunParallel(&job, count, HIE_DEFAULT_CHUNK, threads, parent);
+}
+
+Bool HIE_GetNextNodesParallel(const HIE_Program* program,
+            GeListNode* const* input, GeListNode** output, LONG count,
+            LONG threads, BaseThread* parent) {
+    HIE_EvaluateJob job(NULL, program, input, output);
+    return HIE_RunParallel(&job, count, HIE_DEFAULT_CHUNK, threads, parent);
+}
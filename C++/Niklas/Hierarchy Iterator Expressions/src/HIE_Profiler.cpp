@@ -0,0 +1,244 @@
+/**
+ * Simplified BSD License
+ * Copyright (C) 2013, Niklas Rosenstein. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * official policies, either expressed or implied, of the copyright
+ * holders.
+ *
+ * ***********************************************************************
+ *
+ * HIE_Profiler.h implementation.
+ */
+
+#include "HIE_Profiler.h"
+#include "HIE_Optimizer.h"
+
+HIE_Profiler::HIE_Profiler(const HIE_BaseNode* root)
+: root(root), counters(NULL), count(0) {
+    LONG size = HIE_CountNodes(root);
+    if (size <= 0) return;
+
+    counters = (Counter*) GeAlloc(sizeof(Counter) * size);
+    if (!counters) return;
+
+    count = size;
+    Index(root, 0, 0);
+    Reset();
+}
+
+HIE_Profiler::~HIE_Profiler() {
+    if (counters) GeFree(counters);
+    counters = NULL;
+    count = 0;
+}
+
+LONG HIE_Profiler::Index(const HIE_BaseNode* node, LONG index, LONG depth) {
+    Counter& counter = counters[index];
+    counter.node = node;
+    counter.depth = depth;
+
+    LONG next = index + 1;
+    switch (node->GetType()) {
+        case HIE_NODE_OR: {
+            const HIE_OrOperatorNode* op = (const HIE_OrOperatorNode*) node;
+            next = Index(op->GetLeft(), next, depth + 1);
+            next = Index(op->GetRight(), next, depth + 1);
+            break;
+        }
+        case HIE_NODE_REPEAT:
+            next = Index(((const HIE_RepeatNode*) node)->GetNode(), next, depth + 1);
+            break;
+        case HIE_NODE_CONTAINER: {
+            const HIE_Container* container = (const HIE_Container*) node;
+            LONG size = container->GetCount();
+            LONG child = 0;
+            for (; child < size; child++) {
+                next = Index(container->GetNode(child), next, depth + 1);
+            }
+            break;
+        }
+    }
+
+    counter.size = next - index;
+    return next;
+}
+
+void HIE_Profiler::Reset() {
+    LONG index = 0;
+    for (; index < count; index++) {
+        counters[index].visits = 0;
+        counters[index].nulls = 0;
+        counters[index].time = 0.0;
+    }
+}
+
+GeListNode* HIE_Profiler::GetNextNode(GeListNode* node) {
+    if (!node) return NULL;
+    if (!counters) return root->GetNextNode(node);
+    return Evaluate(0, node);
+}
+
+GeListNode* HIE_Profiler::Evaluate(LONG index, GeListNode* node) {
+    // Mirrors the GetNextNode() implementations of the nodes, calling
+    // back into Evaluate() for the children so they are counted too.
+    Counter& counter = counters[index];
+    const HIE_BaseNode* current = counter.node;
+    Real start = GeGetMilliSeconds();
+    GeListNode* dest = NULL;
+
+    switch (current->GetType()) {
+        case HIE_NODE_OR: {
+            LONG left = index + 1;
+            dest = Evaluate(left, node);
+            if (!dest) dest = Evaluate(left + counters[left].size, node);
+            break;
+        }
+        case HIE_NODE_REPEAT: {
+            const HIE_RepeatNode* repeat = (const HIE_RepeatNode*) current;
+            LONG iterations = 0;
+            dest = node;
+            while (iterations < HIE_RepeatNode::MAX_ITERATIONS) {
+                GeListNode* next = Evaluate(index + 1, dest);
+                if (!next || next == dest) break;
+                dest = next;
+                iterations++;
+            }
+            if (iterations < repeat->GetMinimum()) dest = NULL;
+            break;
+        }
+        case HIE_NODE_CONTAINER: {
+            const HIE_Container* container = (const HIE_Container*) current;
+            LONG size = container->GetCount();
+            LONG child = index + 1;
+            LONG n = 0;
+            switch (container->mode) {
+                case HIE_Container::MODE_CONSECUTIVE:
+                    dest = node;
+                    for (; n < size && dest; n++) {
+                        dest = Evaluate(child, dest);
+                        child += counters[child].size;
+                    }
+                    break;
+                case HIE_Container::MODE_ACCUMULATE:
+                    for (; n < size && node; n++) {
+                        dest = Evaluate(child, node);
+                        if (dest) node = dest;
+                        child += counters[child].size;
+                    }
+                    dest = node;
+                    break;
+                case HIE_Container::MODE_FIRST:
+                    for (; n < size; n++) {
+                        dest = Evaluate(child, node);
+                        if (dest) break;
+                        child += counters[child].size;
+                    }
+                    break;
+            }
+            break;
+        }
+        default:
+            dest = current->GetNextNode(node);
+            break;
+    }
+
+    counter.time += GeGetMilliSeconds() - start;
+    counter.visits++;
+    if (!dest) counter.nulls++;
+    return dest;
+}
+
+String HIE_Profiler::GetLabel(const HIE_BaseNode* node) {
+    switch (node->GetType()) {
+        case HIE_NODE_NEXT:
+            return "next";
+        case HIE_NODE_PRED:
+            return "pred";
+        case HIE_NODE_UP:
+            return "up";
+        case HIE_NODE_DOWN:
+            return "down";
+        case HIE_NODE_CACHE:
+            return "cache";
+        case HIE_NODE_STEP: {
+            const HIE_StepNode* step = (const HIE_StepNode*) node;
+            HIE_StepNode single(step->GetInstruction(), 1);
+            return GetLabel(&single) + " x" + LongToString(step->GetCount());
+        }
+        case HIE_NODE_FILTER:
+            return "filter";
+        case HIE_NODE_OR:
+            return "or";
+        case HIE_NODE_REPEAT:
+            return ((const HIE_RepeatNode*) node)->GetMinimum() ? "repeat+" : "repeat*";
+        case HIE_NODE_CONTAINER:
+            switch (((const HIE_Container*) node)->mode) {
+                case HIE_Container::MODE_CONSECUTIVE:
+                    return "group";
+                case HIE_Container::MODE_ACCUMULATE:
+                    return "accumulate";
+                case HIE_Container::MODE_FIRST:
+                    return "first";
+            }
+            return "group";
+        default:
+            return "node";
+    }
+}
+
+String HIE_Profiler::GetLine(LONG index) const {
+    const Counter& counter = counters[index];
+    String line;
+    LONG depth = 0;
+    for (; depth < counter.depth; depth++) line += "  ";
+
+    line += GetLabel(counter.node);
+    LONG position = counter.node->GetPosition();
+    if (position >= 0) line += " @" + LongToString(position);
+    line += ": " + LongToString(counter.visits) + " visits, " +
+            LongToString(counter.nulls) + " null, " +
+            RealToString(counter.time, -1, 3) + " ms";
+    return line;
+}
+
+String HIE_Profiler::GetReport() const {
+    String report;
+    LONG index = 0;
+    for (; index < count; index++) {
+        report += GetLine(index) + "\n";
+    }
+    return report;
+}
+
+void HIE_Profiler::Print() const {
+    LONG index = 0;
+    for (; index < count; index++) {
+        GePrint(GetLine(index));
+    }
+}
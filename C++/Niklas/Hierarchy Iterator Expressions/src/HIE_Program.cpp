@@ -0,0 +1,560 @@
+/**
+ * Simplified BSD License
+ * Copyright (C) 2013, Niklas Rosenstein. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * official policies, either expressed or implied, of the copyright
+ * holders.
+ *
+ * ***********************************************************************
+ *
+ * HIE_Program.h implementation.
+ */
+
+#include "HIE_Program.h"
+
+/**
+ * Helper for lowering a node tree into opcodes.
+ */
+class HIE_Assembler {
+
+    public:
+
+    /**
+     * The opcodes emitted so far.
+     */
+    GeDynamicArray<HIE_Op> ops;
+
+    /**
+     * The current stack depth.
+     */
+    LONG depth;
+
+    /**
+     * The maximum stack depth reached.
+     */
+    LONG maxDepth;
+
+    HIE_Assembler() : depth(0), maxDepth(0) {}
+
+    /**
+     * @return The index of the next opcode to be emitted.
+     */
+    LONG Here() const {
+        return ops.GetCount();
+    }
+
+    /**
+     * Append an opcode.
+     */
+    Bool Emit(LONG code, LONG arg=0) {
+        HIE_Op op;
+        op.code = code;
+        op.arg = arg;
+
+        switch (code) {
+            case HIE_OP_PUSH:
+                depth++;
+                if (depth > maxDepth) maxDepth = depth;
+                break;
+            case HIE_OP_POP:
+            case HIE_OP_RESTORE:
+            case HIE_OP_ENDREPEAT:
+                depth--;
+                break;
+        }
+        return ops.Push(op);
+    }
+
+    /**
+     * Point the jumps at the passed indices to the current position.
+     */
+    void Patch(const GeDynamicArray<LONG>& jumps) {
+        LONG count = jumps.GetCount();
+        LONG index = 0;
+        LONG target = Here();
+        for (; index < count; index++) {
+            ops[jumps[index]].arg = target;
+        }
+    }
+
+    /**
+     * Emit a group of nodes that returns the first node found. Also
+     * serves the OR operator.
+     */
+    Bool LowerFirst(HIE_BaseNode* const* nodes, LONG count) {
+        if (count <= 0) return Emit(HIE_OP_CLEAR);
+
+        GeDynamicArray<LONG> jumps;
+        LONG index = 0;
+        if (!Emit(HIE_OP_PUSH)) return FALSE;
+        for (; index < count; index++) {
+            if (index > 0 && !Emit(HIE_OP_LOAD)) return FALSE;
+            if (!Lower(nodes[index])) return FALSE;
+            if (index < count - 1) {
+                if (!jumps.Push(Here())) return FALSE;
+                if (!Emit(HIE_OP_JUMPFOUND)) return FALSE;
+            }
+        }
+        Patch(jumps);
+        return Emit(HIE_OP_POP);
+    }
+
+    /**
+     * Lower a node and all of its children.
+     */
+    Bool Lower(const HIE_BaseNode* node) {
+        switch (node->GetType()) {
+            case HIE_NODE_NEXT:
+                return Emit(HIE_OP_NEXT, 1);
+            case HIE_NODE_PRED:
+                return Emit(HIE_OP_PRED, 1);
+            case HIE_NODE_UP:
+                return Emit(HIE_OP_UP, 1);
+            case HIE_NODE_DOWN:
+                return Emit(HIE_OP_DOWN, 1);
+            case HIE_NODE_CACHE:
+                return Emit(HIE_OP_CACHE, 1);
+            case HIE_NODE_STEP: {
+                const HIE_StepNode* step = (const HIE_StepNode*) node;
+                switch (step->GetInstruction()) {
+                    case HIE_NODE_NEXT:
+                        return Emit(HIE_OP_NEXT, step->GetCount());
+                    case HIE_NODE_PRED:
+                        return Emit(HIE_OP_PRED, step->GetCount());
+                    case HIE_NODE_UP:
+                        return Emit(HIE_OP_UP, step->GetCount());
+                    case HIE_NODE_DOWN:
+                        return Emit(HIE_OP_DOWN, step->GetCount());
+                    case HIE_NODE_CACHE:
+                        return Emit(HIE_OP_CACHE, step->GetCount());
+                    default:
+                        return FALSE;
+                }
+            }
+            case HIE_NODE_FILTER: {
+                const HIE_FilterNode* filter = (const HIE_FilterNode*) node;
+                LONG code = (filter->IsNegated() ? HIE_OP_NOTTYPE : HIE_OP_TYPE) +
+                            filter->GetFilter();
+                return Emit(code, filter->GetValue());
+            }
+            case HIE_NODE_OR: {
+                const HIE_OrOperatorNode* op = (const HIE_OrOperatorNode*) node;
+                HIE_BaseNode* nodes[2] = { op->GetLeft(), op->GetRight() };
+                return LowerFirst(nodes, 2);
+            }
+            case HIE_NODE_CONTAINER:
+                return LowerContainer((const HIE_Container*) node);
+            case HIE_NODE_REPEAT: {
+                const HIE_RepeatNode* repeat = (const HIE_RepeatNode*) node;
+                if (!Emit(HIE_OP_PUSH)) return FALSE;
+                LONG body = Here();
+                if (!Lower(repeat->GetNode())) return FALSE;
+                if (!Emit(HIE_OP_LOOP, body)) return FALSE;
+                return Emit(HIE_OP_ENDREPEAT, repeat->GetMinimum());
+            }
+            default:
+                return FALSE;
+        }
+    }
+
+    /**
+     * Lower a HIE_Container respecting its mode.
+     */
+    Bool LowerContainer(const HIE_Container* container) {
+        LONG count = container->GetCount();
+        LONG index = 0;
+
+        switch (container->mode) {
+            case HIE_Container::MODE_CONSECUTIVE: {
+                GeDynamicArray<LONG> jumps;
+                for (; index < count; index++) {
+                    if (!Lower(container->GetNode(index))) return FALSE;
+                    if (index < count - 1) {
+                        if (!jumps.Push(Here())) return FALSE;
+                        if (!Emit(HIE_OP_JUMPNULL)) return FALSE;
+                    }
+                }
+                Patch(jumps);
+                return TRUE;
+            }
+            case HIE_Container::MODE_ACCUMULATE:
+                for (; index < count; index++) {
+                    if (!Emit(HIE_OP_PUSH)) return FALSE;
+                    if (!Lower(container->GetNode(index))) return FALSE;
+                    if (!Emit(HIE_OP_RESTORE)) return FALSE;
+                }
+                return TRUE;
+            case HIE_Container::MODE_FIRST:
+                return LowerFirst(container->GetNodes(), count);
+            default:
+                // HIE_Container::GetNextNode() returns NULL for an
+                // invalid mode.
+                return Emit(HIE_OP_CLEAR);
+        }
+    }
+
+    /**
+     * Retarget jumps that land on opcodes whose outcome is already
+     * known from the jump condition.
+     */
+    void ThreadJumps() {
+        LONG count = ops.GetCount();
+        LONG index = 0;
+        for (; index < count; index++) {
+            HIE_Op& op = ops[index];
+            if (op.code != HIE_OP_JUMPNULL && op.code != HIE_OP_JUMPFOUND)
+                continue;
+
+            Bool null = op.code == HIE_OP_JUMPNULL;
+            LONG target = op.arg;
+            while (target < count) {
+                const HIE_Op& dest = ops[target];
+                if (dest.code == op.code) {
+                    target = dest.arg;
+                }
+                else if (dest.code == HIE_OP_JUMPNULL ||
+                         dest.code == HIE_OP_JUMPFOUND) {
+                    target++;
+                }
+                else if (null && (dest.code <= HIE_OP_CACHE ||
+                                  dest.code >= HIE_OP_TYPE)) {
+                    // Steps and filters keep a NULL node NULL.
+                    target++;
+                }
+                else {
+                    break;
+                }
+            }
+            op.arg = target;
+        }
+    }
+
+};
+
+/**
+ * Executes a single opcode.
+ * @param op The opcode to execute.
+ * @param pc The index of the opcode.
+ * @param node The current node, updated by the opcode.
+ * @param stack The stack of saved nodes.
+ * @param sp The number of entries on the stack, updated by the opcode.
+ * @return The index of the next opcode to execute.
+ */
+static inline LONG HIE_Execute(const HIE_Op& op, LONG pc, GeListNode*& node,
+                               HIE_Frame* stack, LONG& sp) {
+    LONG n;
+    switch (op.code) {
+        case HIE_OP_NEXT:
+            for (n = op.arg; n > 0 && node; n--)
+                node = node->GetNext();
+            break;
+        case HIE_OP_PRED:
+            for (n = op.arg; n > 0 && node; n--)
+                node = node->GetPred();
+            break;
+        case HIE_OP_UP:
+            for (n = op.arg; n > 0 && node; n--)
+                node = node->GetUp();
+            break;
+        case HIE_OP_DOWN:
+            for (n = op.arg; n > 0 && node; n--)
+                node = node->GetDown();
+            break;
+        case HIE_OP_CACHE:
+            for (n = op.arg; n > 0 && node; n--)
+                node = HIE_CacheNode::GetCache(node);
+            break;
+        case HIE_OP_JUMPNULL:
+            if (!node) return op.arg;
+            break;
+        case HIE_OP_JUMPFOUND:
+            if (node) return op.arg;
+            break;
+        case HIE_OP_PUSH:
+            stack[sp].node = node;
+            stack[sp].count = 0;
+            sp++;
+            break;
+        case HIE_OP_LOAD:
+            node = stack[sp - 1].node;
+            break;
+        case HIE_OP_POP:
+            sp--;
+            break;
+        case HIE_OP_RESTORE:
+            sp--;
+            if (!node) node = stack[sp].node;
+            break;
+        case HIE_OP_CLEAR:
+            node = NULL;
+            break;
+        case HIE_OP_LOOP: {
+            HIE_Frame& frame = stack[sp - 1];
+            if (node && node != frame.node) {
+                frame.node = node;
+                frame.count++;
+                if (frame.count < HIE_RepeatNode::MAX_ITERATIONS)
+                    return op.arg;
+            }
+            break;
+        }
+        case HIE_OP_ENDREPEAT:
+            sp--;
+            node = stack[sp].count < op.arg ? NULL : stack[sp].node;
+            break;
+        case HIE_OP_TYPE:
+        case HIE_OP_TAG:
+        case HIE_OP_NAME:
+        case HIE_OP_BIT:
+            if (node && !HIE_FilterNode::Match(op.code - HIE_OP_TYPE, op.arg, node))
+                node = NULL;
+            break;
+        case HIE_OP_NOTTYPE:
+        case HIE_OP_NOTTAG:
+        case HIE_OP_NOTNAME:
+        case HIE_OP_NOTBIT:
+            if (node && HIE_FilterNode::Match(op.code - HIE_OP_NOTTYPE, op.arg, node))
+                node = NULL;
+            break;
+    }
+    return pc + 1;
+}
+
+Bool HIE_Program::Assemble(const HIE_BaseNode* root) {
+    Free();
+
+    HIE_Assembler assembler;
+    if (!assembler.Lower(root)) return FALSE;
+    assembler.ThreadJumps();
+
+    LONG size = assembler.ops.GetCount();
+    if (size > 0) {
+        ops = (HIE_Op*) GeAlloc(sizeof(HIE_Op) * size);
+        if (!ops) return FALSE;
+        memcpy(ops, &assembler.ops[0], sizeof(HIE_Op) * size);
+    }
+    count = size;
+    stackSize = assembler.maxDepth;
+    return TRUE;
+}
+
+Bool HIE_Program::Load(const HIE_Op* ops, LONG count) {
+    Free();
+
+    LONG depth;
+    if (count < 0 || (count > 0 && !ops)) return FALSE;
+    if (!Verify(ops, count, &depth)) return FALSE;
+
+    this->ops = (HIE_Op*) ops;
+    this->count = count;
+    stackSize = depth;
+    borrowed = TRUE;
+    return TRUE;
+}
+
+Bool HIE_Program::Verify(const HIE_Op* ops, LONG count, LONG* stackSize) {
+    if (count < 0) return FALSE;
+
+    // The stack depth on entry of every opcode, -1 if not known yet.
+    // Conditional jumps only go forward, so a single pass suffices.
+    LONG* depths = (LONG*) GeAlloc(sizeof(LONG) * (count + 1) * 2);
+    if (!depths) return FALSE;
+
+    // The first opcode after the PUSH that opened the frame at each
+    // depth, -1 once the frame was popped. A LOOP may only jump there,
+    // so no frame can be reset inside its body and MAX_ITERATIONS
+    // always bounds it.
+    LONG* starts = depths + count + 1;
+
+    LONG pc = 0;
+    for (; pc <= count; pc++) {
+        depths[pc] = -1;
+        starts[pc] = -1;
+    }
+    depths[0] = 0;
+
+    Bool valid = TRUE;
+    LONG maxDepth = 0;
+    for (pc = 0; pc < count && valid; pc++) {
+        const HIE_Op& op = ops[pc];
+        LONG depth = depths[pc];
+        LONG next = depth;
+
+        switch (op.code) {
+            case HIE_OP_NEXT:
+            case HIE_OP_PRED:
+            case HIE_OP_UP:
+            case HIE_OP_DOWN:
+            case HIE_OP_CACHE:
+                valid = op.arg >= 0;
+                break;
+            case HIE_OP_JUMPNULL:
+            case HIE_OP_JUMPFOUND:
+                valid = op.arg > pc && op.arg <= count &&
+                        (depths[op.arg] == -1 || depths[op.arg] == depth);
+                if (valid) depths[op.arg] = depth;
+                break;
+            case HIE_OP_PUSH:
+                next = depth + 1;
+                if (next > maxDepth) maxDepth = next;
+                starts[next] = pc + 1;
+                break;
+            case HIE_OP_LOAD:
+                valid = depth > 0;
+                break;
+            case HIE_OP_POP:
+            case HIE_OP_RESTORE:
+            case HIE_OP_ENDREPEAT:
+                valid = depth > 0;
+                next = depth - 1;
+                if (valid) starts[depth] = -1;
+                break;
+            case HIE_OP_CLEAR:
+            case HIE_OP_TYPE:
+            case HIE_OP_TAG:
+            case HIE_OP_NAME:
+            case HIE_OP_BIT:
+            case HIE_OP_NOTTYPE:
+            case HIE_OP_NOTTAG:
+            case HIE_OP_NOTNAME:
+            case HIE_OP_NOTBIT:
+                break;
+            case HIE_OP_LOOP:
+                valid = depth > 0 && op.arg >= 0 && op.arg <= pc &&
+                        starts[depth] == op.arg;
+                break;
+            default:
+                valid = FALSE;
+                break;
+        }
+
+        if (valid) {
+            valid = depths[pc + 1] == -1 || depths[pc + 1] == next;
+            depths[pc + 1] = next;
+        }
+    }
+
+    GeFree(depths);
+    if (valid && stackSize) *stackSize = maxDepth;
+    return valid;
+}
+
+GeListNode* HIE_Program::GetNextNode(GeListNode* node) const {
+    if (!node) return NULL;
+
+    HIE_Frame local[LOCAL_STACK];
+    HIE_Frame* stack = local;
+    if (stackSize > LOCAL_STACK) {
+        stack = (HIE_Frame*) GeAlloc(sizeof(HIE_Frame) * stackSize);
+        if (!stack) return NULL;
+    }
+
+    LONG sp = 0;
+    LONG pc = 0;
+    while (pc < count) {
+        pc = HIE_Execute(ops[pc], pc, node, stack, sp);
+    }
+
+    if (stack != local) GeFree(stack);
+    return node;
+}
+
+void HIE_Program::GetNextNodes(GeListNode* const* input, GeListNode** output,
+                               LONG total) const {
+    GeListNode* cur[BATCH_SIZE];
+    LONG pc[BATCH_SIZE];
+    LONG sp[BATCH_SIZE];
+    LONG offset = 0;
+    LONG lane;
+
+    HIE_Frame* stacks = NULL;
+    if (stackSize > 0) {
+        stacks = (HIE_Frame*) GeAlloc(sizeof(HIE_Frame) * stackSize *
+                                      BATCH_SIZE);
+        if (!stacks) {
+            for (; offset < total; offset++)
+                output[offset] = GetNextNode(input[offset]);
+            return;
+        }
+    }
+
+    for (; offset < total; offset += BATCH_SIZE) {
+        LONG lanes = total - offset;
+        if (lanes > BATCH_SIZE) lanes = BATCH_SIZE;
+
+        LONG active = 0;
+        for (lane = 0; lane < lanes; lane++) {
+            cur[lane] = input[offset + lane];
+            sp[lane] = 0;
+            pc[lane] = cur[lane] ? 0 : count;
+            if (pc[lane] < count) active++;
+        }
+
+        // Every node that reached an opcode executes it before the next
+        // opcode is visited. A node that jumps back waits for the next
+        // sweep.
+        while (active > 0) {
+            LONG index = 0;
+            for (; index < count && active > 0; index++) {
+                const HIE_Op& op = ops[index];
+                for (lane = 0; lane < lanes; lane++) {
+                    if (pc[lane] != index) continue;
+
+                    GeListNode* node = cur[lane];
+                    LONG next = HIE_Execute(op, index, node,
+                                            stacks + lane * stackSize,
+                                            sp[lane]);
+
+                    cur[lane] = node;
+                    pc[lane] = next;
+                    if (next >= count) active--;
+                }
+            }
+        }
+
+        for (lane = 0; lane < lanes; lane++)
+            output[offset + lane] = cur[lane];
+    }
+
+    if (stacks) GeFree(stacks);
+}
+
+HIE_Program* HIE_CompileProgram(const String& input, HIE_Error* error,
+            HIE_CompilerOptions* options) {
+    HIE_Container* root = HIE_CompileExpression(input, error, options);
+    if (!root) return NULL;
+
+    HIE_Program* program = new HIE_Program;
+    if (program && !program->Assemble(root)) {
+        delete program;
+        program = NULL;
+    }
+    delete root;
+    return program;
+}
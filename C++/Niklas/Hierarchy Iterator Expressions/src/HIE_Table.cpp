@@ -0,0 +1,172 @@
+/**
+ * Simplified BSD License
+ * Copyright (C) 2013, Niklas Rosenstein. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * official policies, either expressed or implied, of the copyright
+ * holders.
+ *
+ * ***********************************************************************
+ *
+ * HIE_Table.h implementation.
+ */
+
+#include "HIE_Table.h"
+
+Bool HIE_ProgramTable::Load(const void* memory, LONG size) {
+    Free();
+
+    if (!memory || ((VULONG) memory & 3) != 0) return FALSE;
+    if (size < (LONG) sizeof(HIE_TableHeader)) return FALSE;
+
+    const char* data = (const char*) memory;
+    const HIE_TableHeader* header = (const HIE_TableHeader*) data;
+    if (header->magic != HIE_TABLE_MAGIC) return FALSE;
+    if (header->version != HIE_TABLE_VERSION) return FALSE;
+    if (header->size < (LONG) sizeof(HIE_TableHeader) || header->size > size) return FALSE;
+    if (header->count < 0) return FALSE;
+
+    size = header->size;
+    LONG begin = sizeof(HIE_TableHeader);
+    if (header->count > (size - begin) / (LONG) sizeof(HIE_TableEntry)) return FALSE;
+    const HIE_TableEntry* entries = (const HIE_TableEntry*) (data + begin);
+    begin += header->count * sizeof(HIE_TableEntry);
+
+    if (header->count > 0) {
+        programs = (HIE_Program**) GeAlloc(sizeof(HIE_Program*) * header->count);
+        if (!programs) return FALSE;
+    }
+
+    LONG index = 0;
+    for (; index < header->count; index++) {
+        const HIE_TableEntry& entry = entries[index];
+        if (entry.offset < begin || entry.count < 0 ||
+            (entry.offset & 3) != 0 ||
+            entry.count > (size - entry.offset) / (LONG) sizeof(HIE_Op)) {
+            Free();
+            return FALSE;
+        }
+
+        HIE_Program* program = new HIE_Program;
+        if (!program) {
+            Free();
+            return FALSE;
+        }
+        programs[count++] = program;
+        if (!program->Load((const HIE_Op*) (data + entry.offset), entry.count)) {
+            Free();
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+void HIE_ProgramTable::Free() {
+    LONG index = 0;
+    for (; index < count; index++) {
+        delete programs[index];
+    }
+    if (programs) GeFree(programs);
+    programs = NULL;
+    count = 0;
+}
+
+Bool HIE_ProgramTableWriter::Add(const HIE_BaseNode* root) {
+    HIE_Program program;
+    if (!program.Assemble(root)) return FALSE;
+    return Add(&program);
+}
+
+Bool HIE_ProgramTableWriter::Add(const HIE_Program* program) {
+    LONG size = program->GetCount();
+    const HIE_Op* source = program->GetOps();
+    LONG start = ops.GetCount();
+    LONG index = 0;
+    for (; index < size; index++) {
+        if (!ops.Push(source[index])) break;
+    }
+
+    // Remove the opcodes of an incomplete program.
+    if (index < size || !counts.Push(size)) {
+        while (ops.GetCount() > start) ops.Pop();
+        return FALSE;
+    }
+    return TRUE;
+}
+
+LONG HIE_ProgramTableWriter::GetSize() const {
+    return sizeof(HIE_TableHeader) +
+           counts.GetCount() * sizeof(HIE_TableEntry) +
+           ops.GetCount() * sizeof(HIE_Op);
+}
+
+Bool HIE_ProgramTableWriter::Write(void* memory, LONG size) const {
+    LONG total = GetSize();
+    if (!memory || size < total) return FALSE;
+
+    char* data = (char*) memory;
+    HIE_TableHeader* header = (HIE_TableHeader*) data;
+    header->magic = HIE_TABLE_MAGIC;
+    header->version = HIE_TABLE_VERSION;
+    header->count = counts.GetCount();
+    header->size = total;
+
+    HIE_TableEntry* entries = (HIE_TableEntry*) (data + sizeof(HIE_TableHeader));
+    LONG offset = sizeof(HIE_TableHeader) + header->count * sizeof(HIE_TableEntry);
+    LONG index = 0;
+    for (; index < header->count; index++) {
+        entries[index].offset = offset;
+        entries[index].count = counts[index];
+        offset += counts[index] * sizeof(HIE_Op);
+    }
+
+    LONG opCount = ops.GetCount();
+    if (opCount > 0) {
+        memcpy(data + sizeof(HIE_TableHeader) + header->count * sizeof(HIE_TableEntry),
+               &ops[0], sizeof(HIE_Op) * opCount);
+    }
+    return TRUE;
+}
+
+Bool HIE_ProgramTableWriter::WriteFile(const Filename& filename) const {
+    LONG size = GetSize();
+    char* memory = (char*) GeAlloc(size);
+    if (!memory) return FALSE;
+
+    Bool success = Write(memory, size);
+    if (success) {
+        AutoAlloc<BaseFile> file;
+        success = file && file->Open(filename, FILEOPEN_WRITE, FILEDIALOG_NONE);
+        if (success) {
+            success = file->WriteBytes(memory, size);
+            success = file->Close() && success;
+        }
+    }
+    GeFree(memory);
+    return success;
+}
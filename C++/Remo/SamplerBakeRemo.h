@@ -0,0 +1,316 @@
+// ------------------------------------------------------------------------------------------------
+// SamplerBakeRemo.h
+// Tiled ShaderSampler Image Baking For C4D
+// Copyright (c) 2003 - 2014 Remotion(Igor Schulz)  http://www.remotion4d.net
+// 
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose, 
+// including commercial applications, and to alter it and redistribute it freely, 
+// subject to the following restrictions:
+// 
+// 1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. 
+// If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+// ------------------------------------------------------------------------------------------------
+#pragma once
+#ifndef _SAMPLER_BAKE_REMO_H_
+#define _SAMPLER_BAKE_REMO_H_
+//=================================================================================================
+//	Bakes the channel of an initialized Sampler into an image.
+//	The image is split into square tiles that are sampled on all threads, every thread keeps
+//	its own Sampler clone. Pixels that differ too much from their neighbors are supersampled.
+//	Finished tiles are collected in bands of one tile row that are handed to a BakeSink,
+//	so only one band has to be in memory and huge images can be streamed to disk.
+//=================================================================================================
+//   Sampler smpl;
+//   if(smpl.Init(textag,CHANNEL_COLOR, 0.0, doc, obj) != INIT_SAMPLER_RESULT_OK) return FALSE;
+//   BakeSettings settings;
+//   settings.width = settings.height = 16384;
+//   PFMBakeSink sink;
+//   if(!sink.Open(Filename("bake.pfm"), settings.width, settings.height)) return FALSE;
+//   if(BakeImage(smpl, settings, sink) != BAKE_RESULT_OK) return FALSE;
+//=================================================================================================
+#include "c4d_file.h"
+#include "c4d_basebitmap.h"
+#include "SamplerParallelRemo.h"
+
+//=================================================================================================
+struct BakeSettings
+{
+	BakeSettings() : width(1024), height(1024), tile(64), supersample(4), threshold(0.05), time(0.0), threads(0) {}
+
+	Int32	width;
+	Int32	height;
+	Int32	tile;			//tile size in pixels, 64x64 tiles keep the per tile data in the cache.
+	Int32	supersample;	//pixels that need it get supersample x supersample extra samples, < 2 means off.
+	Float	threshold;		//max color difference to the right or lower neighbor before a pixel is supersampled.
+	Float	time;
+	Int32	threads;		//<= 0 means one per core.
+};
+
+//=================================================================================================
+// Receives the baked image band by band, a band is rgb float data of width x height pixels,
+// top row first. Bands arrive from top to bottom, or from bottom to top if BottomUp() is true.
+//=================================================================================================
+class BakeSink
+{
+public:
+	virtual ~BakeSink() {}
+	virtual Bool BottomUp() { return false; }
+	virtual Bool WriteBand(Int32 y, Int32 width, Int32 height, const Float32 *rgb) = 0;
+};
+
+//-------------------------------------------------------------------------------------------------
+//writes into a caller allocated float buffer of width * height * 3 values.
+class MemoryBakeSink : public BakeSink
+{
+public:
+	MemoryBakeSink(Float32 *buffer) : rgb(buffer) {}
+
+	virtual Bool WriteBand(Int32 y, Int32 width, Int32 height, const Float32 *band)
+	{
+		if (!rgb) return false;
+		CopyMem(band, rgb + (Int)y*width*3, (Int)width*height*3*sizeof(Float32));
+		return true;
+	}
+
+	Float32 *rgb; //NON owning ptr
+};
+
+//-------------------------------------------------------------------------------------------------
+//writes into an initialized BaseBitmap of the same size, colors are clamped to [0,1].
+class BitmapBakeSink : public BakeSink
+{
+public:
+	BitmapBakeSink(BaseBitmap *bitmap) : bmp(bitmap) {}
+
+	virtual Bool WriteBand(Int32 y, Int32 width, Int32 height, const Float32 *band)
+	{
+		if (!bmp) return false;
+		for (Int32 j=0; j<height; ++j){
+			for (Int32 i=0; i<width; ++i){
+				const Float32 *c = band + ((Int)j*width + i)*3;
+				bmp->SetPixel(i, y+j, (Int32)(FCut(c[0],0.0,1.0)*255.0+0.5), (Int32)(FCut(c[1],0.0,1.0)*255.0+0.5), (Int32)(FCut(c[2],0.0,1.0)*255.0+0.5));
+			}
+		}
+		return true;
+	}
+
+	BaseBitmap *bmp; //NON owning ptr
+};
+
+//-------------------------------------------------------------------------------------------------
+//streams the image into a little endian portable float map (.pfm) file.
+//PFM stores the bottom row first, so the bands are requested from bottom to top.
+class PFMBakeSink : public BakeSink
+{
+public:
+	Bool Open(const Filename &fn, Int32 width, Int32 height)
+	{
+		if (!file) return false;
+		if (!file->Open(fn, FILEOPEN_WRITE, FILEDIALOG_NONE, BYTEORDER_INTEL)) return false;
+		const String header = "PF\n" + String::IntToString(width) + " " + String::IntToString(height) + "\n-1.0\n";
+		Char buf[64];
+		header.GetCString(buf, sizeof(buf), STRINGENCODING_XBIT);
+		return file->WriteBytes(buf, header.GetLength()) != 0;
+	}
+	Bool Close() { return file ? file->Close() : false; }
+
+	virtual Bool BottomUp() { return true; }
+	virtual Bool WriteBand(Int32 y, Int32 width, Int32 height, const Float32 *band)
+	{
+		if (!file) return false;
+		for (Int32 j=height-1; j>=0; --j){
+			if (!file->WriteBytes(band + (Int)j*width*3, (Int)width*3*sizeof(Float32))) return false;
+		}
+		return true;
+	}
+
+	AutoAlloc<BaseFile> file;
+};
+
+//=================================================================================================
+class BakeTileJob : public ParallelSamplerJob
+//=================================================================================================
+{
+public:
+	BakeTileJob(const BakeSettings &s, Float32 *b) : settings(s), band(b), y0(0), rows(0), failed(false)
+	{
+		for (Int32 i=0; i<MAX_THREADS; ++i) { samples[i] = 0; supersampled[i] = 0; }
+	}
+
+	//every work item is one tile of the current band.
+	virtual void Run(Sampler &smpl, Int32 thread, Int32 start, Int32 end)
+	{
+		for (Int32 t=start; t<end; ++t) BakeTile(smpl, thread % MAX_THREADS, t);
+	}
+
+	Int64 GetSamples() const		{ Int64 n = 0; for (Int32 i=0; i<MAX_THREADS; ++i) n += samples[i]; return n; }
+	Int64 GetSupersampled() const	{ Int64 n = 0; for (Int32 i=0; i<MAX_THREADS; ++i) n += supersampled[i]; return n; }
+
+	static const Int32 MAX_THREADS = 64;
+	static const Int32 CHUNK = 256; //supersampled pixels sampled at once.
+
+	const BakeSettings &settings;
+	Float32			   *band;	//width x rows rgb of the current band.
+	Int32				y0;		//first image row of the band.
+	Int32				rows;	//rows in the band.
+	Bool				failed;	//set by a thread that could not allocate, the band is incomplete.
+
+private:
+	void BakeTile(Sampler &smpl, Int32 thread, Int32 index)
+	{
+		const Int32 W  = settings.width;
+		const Int32 H  = settings.height;
+		const Int32 x0 = index * settings.tile;
+		const Int32 tw = Min(settings.tile, W - x0);
+		const Int32 th = rows;
+		const Int32 ss = settings.supersample;
+
+		//one extra column and row of pixel centers on every side to compare the pixels at the tile border,
+		//so both pixels of a differing pair are marked, no matter which tile or band they belong to.
+		const Int32 ol = (x0 > 0) ? 1 : 0;
+		const Int32 ot = (y0 > 0) ? 1 : 0;
+		const Int32 pw = ol + tw + ((x0+tw < W) ? 1 : 0);
+		const Int32 ph = ot + th + ((y0+th < H) ? 1 : 0);
+		const Int32 n  = pw*ph;
+
+		maxon::BaseArray<Float> buf;
+		if (!buf.Resize((Int)n*5)) { failed = true; return; }
+		Float *u = &buf[0], *v = u+n, *r = v+n, *g = r+n, *b = g+n;
+		const Float iw = 1.0 / (Float)W, ih = 1.0 / (Float)H;
+		for (Int32 j=0; j<ph; ++j){
+			for (Int32 i=0; i<pw; ++i){
+				u[j*pw+i] = (x0 - ol + i + 0.5)*iw;
+				v[j*pw+i] = (y0 - ot + j + 0.5)*ih;
+			}
+		}
+		SamplerBatch batch;
+		batch.count = n;
+		batch.u = u; batch.v = v;
+		batch.r = r; batch.g = g; batch.b = b;
+		batch.time = settings.time;
+		smpl.SampleUV(batch);
+		samples[thread] += n;
+
+		for (Int32 j=0; j<th; ++j){
+			for (Int32 i=0; i<tw; ++i){
+				Float32 *o = band + ((Int)j*W + x0 + i)*3;
+				const Int32 k = (j+ot)*pw + i+ol;
+				o[0] = (Float32)r[k]; o[1] = (Float32)g[k]; o[2] = (Float32)b[k];
+			}
+		}
+		if (ss < 2) return;
+
+		//mark pixels that differ from the right or lower neighbor, and the neighbor too.
+		//The first column and row also compare with the left and upper apron, the neighbor tile marks its side.
+		maxon::BaseArray<Bool>	mark;
+		maxon::BaseArray<Int32> list;
+		if (!mark.Resize((Int)tw*th)) { failed = true; return; }
+		for (Int32 k=0; k<tw*th; ++k) mark[k] = false;
+		for (Int32 j=0; j<th; ++j){
+			for (Int32 i=0; i<tw; ++i){
+				const Int32 k = (j+ot)*pw + i+ol;
+				if (i+ol+1 < pw && Diff(r,g,b,k,k+1) > settings.threshold){
+					mark[j*tw+i] = true;
+					if (i+1 < tw) mark[j*tw+i+1] = true;
+				}
+				if (j+ot+1 < ph && Diff(r,g,b,k,k+pw) > settings.threshold){
+					mark[j*tw+i] = true;
+					if (j+1 < th) mark[(j+1)*tw+i] = true;
+				}
+				if (i == 0 && ol && Diff(r,g,b,k,k-1) > settings.threshold) mark[j*tw+i] = true;
+				if (j == 0 && ot && Diff(r,g,b,k,k-pw) > settings.threshold) mark[j*tw+i] = true;
+			}
+		}
+		for (Int32 k=0; k<tw*th; ++k){
+			if (mark[k] && !list.Append(k)) { failed = true; return; }
+		}
+		if (!list.GetCount()) return;
+		supersampled[thread] += list.GetCount();
+
+		//stratified ss x ss samples per pixel, averaged together with the center sample.
+		const Int32 per = ss*ss;
+		const Int32 m	= (Int32)Min((Int)CHUNK, list.GetCount()) * per;
+		maxon::BaseArray<Float> sbuf;
+		if (!sbuf.Resize((Int)m*5)) { failed = true; return; }
+		Float *su = &sbuf[0], *sv = su+m, *sr = sv+m, *sg = sr+m, *sb = sg+m;
+		const Float step = 1.0 / (Float)ss;
+		for (Int32 first=0; first < list.GetCount(); first += CHUNK){
+			const Int32 cnt = (Int32)Min((Int)CHUNK, list.GetCount() - first);
+			for (Int32 p=0; p<cnt; ++p){
+				const Int32 k = list[first+p];
+				const Int32 i = k % tw, j = k / tw;
+				for (Int32 sj=0; sj<ss; ++sj){
+					for (Int32 si=0; si<ss; ++si){
+						su[p*per + sj*ss + si] = (x0 + i + (si + 0.5)*step)*iw;
+						sv[p*per + sj*ss + si] = (y0 + j + (sj + 0.5)*step)*ih;
+					}
+				}
+			}
+			SamplerBatch sbatch;
+			sbatch.count = cnt*per;
+			sbatch.u = su; sbatch.v = sv;
+			sbatch.r = sr; sbatch.g = sg; sbatch.b = sb;
+			sbatch.time = settings.time;
+			smpl.SampleUV(sbatch);
+			samples[thread] += sbatch.count;
+
+			const Float inv = 1.0 / (Float)(per + 1);
+			for (Int32 p=0; p<cnt; ++p){
+				const Int32 k = list[first+p];
+				const Int32 i = k % tw, j = k / tw;
+				Float32 *o = band + ((Int)j*W + x0 + i)*3;
+				Float cr = o[0], cg = o[1], cb = o[2];
+				for (Int32 q=p*per; q<(p+1)*per; ++q) { cr += sr[q]; cg += sg[q]; cb += sb[q]; }
+				o[0] = (Float32)(cr*inv); o[1] = (Float32)(cg*inv); o[2] = (Float32)(cb*inv);
+			}
+		}
+	}
+
+	static Float Diff(const Float *r, const Float *g, const Float *b, Int32 a, Int32 c)
+	{
+		return Max(Max(Abs(r[a]-r[c]), Abs(g[a]-g[c])), Abs(b[a]-b[c]));
+	}
+
+	Int64 samples[MAX_THREADS];
+	Int64 supersampled[MAX_THREADS];
+};
+
+//-------------------------------------------------------------------------------------------------
+//bake the channel of smpl (initialized by the caller) with SampleUV into sink.
+//samples and supersampled may be nullptr, they receive the number of shader samples and supersampled pixels.
+inline BAKE_RESULT BakeImage(Sampler &smpl, const BakeSettings &settings, BakeSink &sink, BaseThread *parent = nullptr, Int64 *samples = nullptr, Int64 *supersampled = nullptr)
+{
+	if (!smpl.IsInit() || settings.width <= 0 || settings.height <= 0 || settings.tile <= 0) return BAKE_RESULT_WRONG_PARAM;
+
+	const Int32 W	  = settings.width;
+	const Int32 T	  = settings.tile;
+	const Int32 tiles = (W - 1) / T + 1;
+	const Int32 bands = (settings.height - 1) / T + 1;
+
+	maxon::BaseArray<Float32> band;
+	if (!band.Resize((Int)W*T*3)) return BAKE_RESULT_OUT_OF_MEMORY;
+
+	ParallelSampler psmpl;
+	if (!psmpl.Init(smpl, Min(settings.threads > 0 ? settings.threads : GeGetCurrentThreadCount(), (Int32)BakeTileJob::MAX_THREADS))) return BAKE_RESULT_OUT_OF_MEMORY;
+
+	BakeTileJob job(settings, band.GetFirst());
+	const Bool up = sink.BottomUp();
+	BAKE_RESULT res = BAKE_RESULT_OK;
+	for (Int32 k=0; k<bands; ++k){
+		const Int32 bi = up ? bands-1-k : k;
+		job.y0	 = bi * T;
+		job.rows = Min(T, settings.height - job.y0);
+		if (!psmpl.Run(job, tiles, 1, parent)) { res = BAKE_RESULT_BREAK; break; }
+		if (job.failed) { res = BAKE_RESULT_OUT_OF_MEMORY; break; }
+		if (!sink.WriteBand(job.y0, W, job.rows, band.GetFirst())) { res = BAKE_RESULT_WRITE_ERROR; break; }
+	}
+	if (samples) *samples = job.GetSamples();
+	if (supersampled) *supersampled = job.GetSupersampled();
+	return res;
+}
+
+#endif//_SAMPLER_BAKE_REMO_H_
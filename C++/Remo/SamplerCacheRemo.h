@@ -0,0 +1,290 @@
+// ------------------------------------------------------------------------------------------------
+// SamplerCacheRemo.h
+// Baked ShaderSampler Cache For C4D
+// Copyright (c) 2003 - 2014 Remotion(Igor Schulz)  http://www.remotion4d.net
+// 
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose, 
+// including commercial applications, and to alter it and redistribute it freely, 
+// subject to the following restrictions:
+// 
+// 1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. 
+// If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+// ------------------------------------------------------------------------------------------------
+#pragma once
+#ifndef _SAMPLER_CACHE_REMO_H_
+#define _SAMPLER_CACHE_REMO_H_
+//=================================================================================================
+//	Rasterizes the channel of an initialized Sampler once into a tiled, mipmapped texture
+//	and serves SampleUV from it with bilinear or trilinear lookups.
+//	The baked texture covers shader uv [0,1] and repeats outside of it.
+//=================================================================================================
+//   Sampler smpl;
+//   if(smpl.Init(mat,CHANNEL_COLOR, 0.0, doc) != INIT_SAMPLER_RESULT_OK) return FALSE;
+//   SamplerCache cache;
+//   if(!cache.Bake(smpl, 1024)) return FALSE;
+//   ...
+//   if(!cache.Update(smpl)) return FALSE; //rebake only if the material was changed.
+//   const Vector color = cache.SampleUV(uv);
+//=================================================================================================
+#include "SamplerParallelRemo.h"
+
+//=================================================================================================
+class SamplerCache
+//=================================================================================================
+{
+public:
+	SamplerCache();
+	~SamplerCache();
+
+	//rasterize the channel of smpl, resolution is rounded up to a power of two.
+	//threads <= 0 means one per core.
+	Bool Bake(Sampler &smpl, Int32 resolution, Float time = 0.0, Int32 threads = 0, BaseThread *parent = nullptr);
+
+	//return true if something was baked and material and shader did not change since.
+	Bool IsValid() const;
+
+	//bake again with the last settings if the cache is not valid anymore.
+	Bool Update(Sampler &smpl, BaseThread *parent = nullptr);
+
+	//return cached color at UVW coordinates like Sampler::SampleUV.
+	//filter_width is the sample footprint in uv, 0.0 means bilinear lookup in the full resolution,
+	//bigger values select trilinear lookup in the mip levels.
+	Vector SampleUV(const Vector &uv, Float filter_width = 0.0) const;
+
+	//return bilinear color of mip level at shader uv coordinates (no offset/length transform).
+	Vector Lookup(Float u, Float v, Int32 level) const;
+
+	Int32 GetResolution() const { return levels.GetCount() ? levels[0].size : 0; }
+	Int32 GetLevelCount() const { return (Int32)levels.GetCount(); }
+
+	void Free();
+
+	//size of the square tiles the levels are stored in.
+	static const Int32 TILE = 32;
+
+private:
+	struct Level
+	{
+		Int32	size;	//texels per side
+		Int32	tile;	//texels per tile side
+		Int32	tiles;	//tiles per row
+		Int		offset; //first texel in data
+	};
+	class BakeJob;
+
+	inline Int Texel(const Level &l, Int32 x, Int32 y) const
+	{
+		const Int32 tx = x / l.tile, ty = y / l.tile;
+		return l.offset + ((Int)(ty*l.tiles + tx)*l.tile + (y - ty*l.tile))*l.tile + (x - tx*l.tile);
+	}
+	void BuildMips();
+
+	maxon::BaseArray<Level>		levels;
+	maxon::BaseArray<Float32>	data; //3 floats per texel
+
+	BaseMaterial	*mat;	 //NON owning ptr
+	BaseShader		*shader; //NON owning ptr
+	UInt32			 matDirty;
+	UInt32			 shaderDirty;
+	Vector			 offset;
+	Vector			 length;
+	Float			 time;
+	Int32			 threads;
+};
+//-------------------------------------------------------------------------------------------------
+class SamplerCache::BakeJob : public ParallelSamplerJob
+{
+public:
+	BakeJob(SamplerCache &c) : cache(c), failed(false) {}
+
+	//every work item is one row of level 0.
+	virtual void Run(Sampler &smpl, Int32 thread, Int32 start, Int32 end)
+	{
+		const Level &l	 = cache.levels[0];
+		const Int32 size = l.size;
+		maxon::BaseArray<Float> buf;
+		if (!buf.Resize(size*5)) { failed = true; return; }
+		Float *u = &buf[0], *v = u+size, *r = v+size, *g = r+size, *b = g+size;
+
+		SamplerBatch batch;
+		batch.count = size;
+		batch.u		= u;
+		batch.v		= v;
+		batch.r		= r;
+		batch.g		= g;
+		batch.b		= b;
+		batch.time	= cache.time;
+
+		//texel centers in shader uv, mapped back through the sampler uv transform.
+		const Float inv = 1.0 / (Float)size;
+		for (Int32 x=0; x<size; ++x) u[x] = ((x + 0.5)*inv)*cache.length.x + cache.offset.x;
+		for (Int32 y=start; y<end; ++y){
+			const Float vy = ((y + 0.5)*inv)*cache.length.y + cache.offset.y;
+			for (Int32 x=0; x<size; ++x) v[x] = vy;
+			smpl.SampleUV(batch);
+			for (Int32 x=0; x<size; ++x){
+				Float32 *t = &cache.data[cache.Texel(l,x,y)*3];
+				t[0] = (Float32)r[x];
+				t[1] = (Float32)g[x];
+				t[2] = (Float32)b[x];
+			}
+		}
+	}
+
+	SamplerCache	&cache;
+	Bool			 failed; //set by a thread that could not allocate its buffer
+};
+//-------------------------------------------------------------------------------------------------
+inline SamplerCache::SamplerCache()
+{
+	mat			= nullptr;
+	shader		= nullptr;
+	matDirty	= 0;
+	shaderDirty = 0;
+	time		= 0.0;
+	threads		= 0;
+	offset		= Vector(0.0);
+	length		= Vector(1.0);
+}
+//-------------------------------------------------------------------------------------------------
+inline SamplerCache::~SamplerCache()
+{
+	Free();
+}
+//-------------------------------------------------------------------------------------------------
+inline void SamplerCache::Free()
+{
+	levels.Reset();
+	data.Reset();
+	mat	   = nullptr;
+	shader = nullptr;
+}
+//-------------------------------------------------------------------------------------------------
+inline Bool SamplerCache::Bake(Sampler &smpl, Int32 resolution, Float t, Int32 thread_count, BaseThread *parent)
+{
+	Free();
+	if (!smpl.IsInit() || resolution <= 0 || resolution > (1<<15)) return false;
+	Int32 size = 1;
+	while (size < resolution) size <<= 1;
+
+	//all levels down to 1x1, each stored in tiles of at most TILE x TILE texels.
+	Int total = 0;
+	for (Int32 s=size; s>=1; s>>=1){
+		Level l;
+		l.size	 = s;
+		l.tile	 = Min(s, TILE);
+		l.tiles	 = s / l.tile;
+		l.offset = total;
+		if (!levels.Append(l)) { Free(); return false; }
+		total += (Int)s*s;
+	}
+	if (!data.Resize(total*3)) { Free(); return false; }
+
+	mat			= smpl.GetTexData()->mp;
+	shader		= smpl.GetShader();
+	matDirty	= mat ? mat->GetDirty(DIRTYFLAGS_DATA) : 0;
+	shaderDirty = shader ? shader->GetDirty(DIRTYFLAGS_DATA) : 0;
+	offset		= smpl.GetUVOffset();
+	length		= smpl.GetUVLength();
+	time		= t;
+	threads		= thread_count;
+
+	ParallelSampler psmpl;
+	if (!psmpl.Init(smpl, threads)) { Free(); return false; }
+	BakeJob job(*this);
+	if (!psmpl.Run(job, size, Max(1, ParallelSampler::DEFAULT_TILE / size), parent) || job.failed) { Free(); return false; }
+	BuildMips();
+	return true;
+}
+//-------------------------------------------------------------------------------------------------
+inline void SamplerCache::BuildMips()
+{
+	//2x2 box filter of the level above.
+	for (Int32 i=1; i<levels.GetCount(); ++i){
+		const Level &src = levels[i-1];
+		const Level &dst = levels[i];
+		for (Int32 y=0; y<dst.size; ++y){
+			for (Int32 x=0; x<dst.size; ++x){
+				const Float32 *a = &data[Texel(src,2*x  ,2*y  )*3];
+				const Float32 *b = &data[Texel(src,2*x+1,2*y  )*3];
+				const Float32 *c = &data[Texel(src,2*x  ,2*y+1)*3];
+				const Float32 *d = &data[Texel(src,2*x+1,2*y+1)*3];
+				Float32 *t = &data[Texel(dst,x,y)*3];
+				for (Int32 k=0; k<3; ++k) t[k] = (a[k] + b[k] + c[k] + d[k]) * 0.25f;
+			}
+		}
+	}
+}
+//-------------------------------------------------------------------------------------------------
+inline Bool SamplerCache::IsValid() const
+{
+	if (!levels.GetCount()) return false;
+	if (mat && mat->GetDirty(DIRTYFLAGS_DATA) != matDirty) return false;
+	if (shader && shader->GetDirty(DIRTYFLAGS_DATA) != shaderDirty) return false;
+	return true;
+}
+//-------------------------------------------------------------------------------------------------
+inline Bool SamplerCache::Update(Sampler &smpl, BaseThread *parent)
+{
+	if (IsValid()) return true;
+	const Int32 size = GetResolution();
+	if (size <= 0) return false;
+	return Bake(smpl, size, time, threads, parent);
+}
+//-------------------------------------------------------------------------------------------------
+inline Vector SamplerCache::Lookup(Float u, Float v, Int32 level) const
+{
+	const Level &l = levels[level];
+	const Int32 size = l.size;
+
+	//texel centers are at (i + 0.5) / size, the texture repeats.
+	const Float fx = u*size - 0.5;
+	const Float fy = v*size - 0.5;
+	const Float ix = Floor(fx);
+	const Float iy = Floor(fy);
+	const Float wx = fx - ix;
+	const Float wy = fy - iy;
+	Int32 x0 = (Int32)ix % size; if (x0 < 0) x0 += size;
+	Int32 y0 = (Int32)iy % size; if (y0 < 0) y0 += size;
+	const Int32 x1 = (x0 + 1 == size) ? 0 : x0 + 1;
+	const Int32 y1 = (y0 + 1 == size) ? 0 : y0 + 1;
+
+	const Float32 *a = &data[Texel(l,x0,y0)*3];
+	const Float32 *b = &data[Texel(l,x1,y0)*3];
+	const Float32 *c = &data[Texel(l,x0,y1)*3];
+	const Float32 *d = &data[Texel(l,x1,y1)*3];
+	const Float w00 = (1.0-wx)*(1.0-wy), w10 = wx*(1.0-wy), w01 = (1.0-wx)*wy, w11 = wx*wy;
+	return Vector(a[0]*w00 + b[0]*w10 + c[0]*w01 + d[0]*w11,
+				  a[1]*w00 + b[1]*w10 + c[1]*w01 + d[1]*w11,
+				  a[2]*w00 + b[2]*w10 + c[2]*w01 + d[2]*w11);
+}
+//-------------------------------------------------------------------------------------------------
+inline Vector SamplerCache::SampleUV(const Vector &uv, Float filter_width) const
+{
+	if (!levels.GetCount()) return Vector(0.0);
+
+	//same transform as Sampler::SampleUV, then wrap into [0,1).
+	Float u = (uv.x-offset.x) / length.x;
+	Float v = (uv.y-offset.y) / length.y;
+	u -= Floor(u);
+	v -= Floor(v);
+
+	if (filter_width <= 0.0) return Lookup(u, v, 0);
+
+	//footprint in texels of level 0 selects the mip level.
+	const Float footprint = filter_width / Max(Abs(length.x), Abs(length.y)) * levels[0].size;
+	if (footprint <= 1.0) return Lookup(u, v, 0);
+	const Float lod = Min(Ln(footprint)/Ln(2.0), (Float)(levels.GetCount()-1));
+	const Int32 l0	= (Int32)lod;
+	const Int32 l1	= Min(l0+1, (Int32)levels.GetCount()-1);
+	const Float w	= lod - l0;
+	const Vector c0 = Lookup(u, v, l0);
+	if (w <= 0.0 || l1 == l0) return c0;
+	return c0 + (Lookup(u, v, l1) - c0) * w;
+}
+
+#endif//_SAMPLER_CACHE_REMO_H_
@@ -0,0 +1,208 @@
+// ------------------------------------------------------------------------------------------------
+// SamplerMultiRemo.h
+// Multi Channel ShaderSampler For C4D
+// Copyright (c) 2003 - 2014 Remotion(Igor Schulz)  http://www.remotion4d.net
+// 
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose, 
+// including commercial applications, and to alter it and redistribute it freely, 
+// subject to the following restrictions:
+// 
+// 1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. 
+// If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+// ------------------------------------------------------------------------------------------------
+#pragma once
+#ifndef _SAMPLER_MULTI_REMO_H_
+#define _SAMPLER_MULTI_REMO_H_
+//=================================================================================================
+//	Samples several channels of one material in one pass.
+//	All channels are initialized once, the uv transform and projection of every point
+//	are computed once and shared by all channels.
+//=================================================================================================
+//   const Int32 channels[] = { CHANNEL_COLOR, CHANNEL_BUMP, CHANNEL_SPECULAR };
+//   MultiSampler msmpl;
+//   if(msmpl.Init(textag, channels, 3, 0.0, doc, obj) != INIT_SAMPLER_RESULT_OK) return FALSE;
+//   maxon::BaseArray<Vector> colors; colors.Resize(batch.count * 3);
+//   msmpl.SampleUV(batch, colors.GetFirst()); //colors[i*3 + c] is channel c of point i.
+//=================================================================================================
+#include "SamplerRemo.h"
+
+//=================================================================================================
+class MultiSampler
+//=================================================================================================
+{
+public:
+	MultiSampler();
+	~MultiSampler();
+
+	//init count channels, fails if one of them can not be initialized.
+	INIT_SAMPLER_RESULT Init(BaseMaterial *mat, const Int32 *channels, Int32 count, Float time, BaseDocument *doc, BaseObject *op=nullptr);
+	INIT_SAMPLER_RESULT Init(TextureTag *textag, const Int32 *channels, Int32 count, Float time, BaseDocument *doc, BaseObject *op=nullptr);
+
+	Int32	 GetChannelCount() const { return (Int32)samplers.GetCount(); }
+	Int32	 GetChannel(Int32 i) const { return channel[i]; }
+	Sampler* GetSampler(Int32 i) { return samplers[i]; }
+
+	//sample all channels at batch like Sampler::SampleUV/Sample3D, batch.r/g/b are not used.
+	//out must hold batch.count * GetChannelCount() colors,
+	//interleaved: out[i*GetChannelCount() + c], planar: out[c*batch.count + i] is channel c of point i.
+	void SampleUV(const SamplerBatch &batch, Vector *out, Bool interleaved = true);
+	void Sample3D(const SamplerBatch &batch, Vector *out, Bool interleaved = true);
+
+	//project count points with the texture of the channels (see Sampler::ProjectPoints) and sample all channels there.
+	//n may be nullptr, out like SampleUV.
+	void SampleProjected(const Vector *p, const Vector *n, Int32 count, Vector *out, Bool interleaved = true, Float time = 0.0);
+
+	void Free();
+
+	//number of points processed at once.
+	static const Int32 BLOCK = 256;
+
+private:
+	void Sample(const SamplerBatch &batch, Bool transform, Bool use3d, Vector *out, Bool interleaved);
+
+	maxon::BaseArray<Sampler*>	samplers; //Owning ptrs
+	maxon::BaseArray<Int32>		channel;
+};
+//-------------------------------------------------------------------------------------------------
+inline MultiSampler::MultiSampler()
+{
+}
+//-------------------------------------------------------------------------------------------------
+inline MultiSampler::~MultiSampler()
+{
+	Free();
+}
+//-------------------------------------------------------------------------------------------------
+inline void MultiSampler::Free()
+{
+	for (Int32 i=0; i<samplers.GetCount(); ++i){
+		DeleteObj(samplers[i]);
+	}
+	samplers.Flush();
+	channel.Flush();
+}
+//-------------------------------------------------------------------------------------------------
+inline INIT_SAMPLER_RESULT MultiSampler::Init(BaseMaterial *mat, const Int32 *channels, Int32 count, Float time, BaseDocument *doc, BaseObject *op)
+{
+	Free();
+	if (!mat || !channels || count <= 0) return INIT_SAMPLER_RESULT_WRONG_PARAM;
+	for (Int32 i=0; i<count; ++i){
+		Sampler *smpl = NewObj(Sampler);
+		if (!smpl || !samplers.Append(smpl)) { DeleteObj(smpl); Free(); return INIT_SAMPLER_RESULT_WRONG_PARAM; }
+		if (!channel.Append(channels[i])) { Free(); return INIT_SAMPLER_RESULT_WRONG_PARAM; }
+		const INIT_SAMPLER_RESULT res = smpl->Init(mat,channels[i],time,doc,op);
+		if (res != INIT_SAMPLER_RESULT_OK) { Free(); return res; }
+	}
+	return INIT_SAMPLER_RESULT_OK;
+}
+//-------------------------------------------------------------------------------------------------
+inline INIT_SAMPLER_RESULT MultiSampler::Init(TextureTag *textag, const Int32 *channels, Int32 count, Float time, BaseDocument *doc, BaseObject *op)
+{
+	Free();
+	if (!textag || !channels || count <= 0) return INIT_SAMPLER_RESULT_WRONG_PARAM;
+	for (Int32 i=0; i<count; ++i){
+		Sampler *smpl = NewObj(Sampler);
+		if (!smpl || !samplers.Append(smpl)) { DeleteObj(smpl); Free(); return INIT_SAMPLER_RESULT_WRONG_PARAM; }
+		if (!channel.Append(channels[i])) { Free(); return INIT_SAMPLER_RESULT_WRONG_PARAM; }
+		const INIT_SAMPLER_RESULT res = smpl->Init(textag,channels[i],time,doc,op);
+		if (res != INIT_SAMPLER_RESULT_OK) { Free(); return res; }
+	}
+	return INIT_SAMPLER_RESULT_OK;
+}
+//-------------------------------------------------------------------------------------------------
+inline void MultiSampler::SampleUV(const SamplerBatch &batch, Vector *out, Bool interleaved)
+{
+	Sample(batch, true, false, out, interleaved);
+}
+//-------------------------------------------------------------------------------------------------
+inline void MultiSampler::Sample3D(const SamplerBatch &batch, Vector *out, Bool interleaved)
+{
+	if (!batch.px || !batch.py || !batch.pz) return;
+	Sample(batch, false, true, out, interleaved);
+}
+//-------------------------------------------------------------------------------------------------
+inline void MultiSampler::Sample(const SamplerBatch &batch, Bool transform, Bool use3d, Vector *out, Bool interleaved)
+{
+	const Int32 cc = GetChannelCount();
+	if (cc <= 0 || !out || !batch.u || !batch.v) return;
+
+	//all channels share the texture, so the uv transform of the first one is done once for all.
+	const Vector off = transform ? samplers[0]->GetUVOffset() : Vector(0.0);
+	const Vector len = transform ? samplers[0]->GetUVLength() : Vector(1.0);
+
+	Float su[BLOCK], sv[BLOCK], r[BLOCK], g[BLOCK], b[BLOCK];
+	SamplerBatch sub;
+	sub.u	 = su;
+	sub.v	 = sv;
+	sub.r	 = r;
+	sub.g	 = g;
+	sub.b	 = b;
+	sub.time = batch.time;
+
+	for (Int32 start=0; start < batch.count; start += BLOCK){
+		const Int32 cnt = Min(BLOCK, batch.count - start);
+		for (Int32 i=0; i<cnt; ++i) su[i] = (batch.u[start+i]-off.x) / len.x;
+		for (Int32 i=0; i<cnt; ++i) sv[i] = (batch.v[start+i]-off.y) / len.y;
+		sub.count = cnt;
+		sub.w	  = batch.w ? batch.w + start : nullptr;
+		sub.t	  = batch.t ? batch.t + start : nullptr;
+		sub.px	  = use3d ? batch.px + start : nullptr;
+		sub.py	  = use3d ? batch.py + start : nullptr;
+		sub.pz	  = use3d ? batch.pz + start : nullptr;
+
+		for (Int32 c=0; c<cc; ++c){
+			samplers[c]->SampleShader(sub);
+			if (interleaved){
+				Vector *o = out + (Int)start*cc + c;
+				for (Int32 i=0; i<cnt; ++i) o[(Int)i*cc] = Vector(r[i],g[i],b[i]);
+			}else{
+				Vector *o = out + (Int)c*batch.count + start;
+				for (Int32 i=0; i<cnt; ++i) o[i] = Vector(r[i],g[i],b[i]);
+			}
+		}
+	}
+}
+//-------------------------------------------------------------------------------------------------
+inline void MultiSampler::SampleProjected(const Vector *p, const Vector *n, Int32 count, Vector *out, Bool interleaved, Float time)
+{
+	if (GetChannelCount() <= 0 || !p || !out) return;
+
+	Vector uv[BLOCK];
+	Float  u[BLOCK], v[BLOCK], w[BLOCK], px[BLOCK], py[BLOCK], pz[BLOCK];
+	SamplerBatch batch;
+	batch.u	   = u;
+	batch.v	   = v;
+	batch.w	   = w;
+	batch.px   = px;
+	batch.py   = py;
+	batch.pz   = pz;
+	batch.time = time;
+
+	const Int32 cc = GetChannelCount();
+	maxon::BaseArray<Vector> tmp;
+	if (!interleaved && !tmp.Resize((Int)BLOCK*cc)) return;
+
+	for (Int32 start=0; start < count; start += BLOCK){
+		const Int32 cnt = Min(BLOCK, count - start);
+		samplers[0]->ProjectPoints(p + start, n ? n + start : nullptr, cnt, uv);
+		for (Int32 i=0; i<cnt; ++i){
+			u[i]  = uv[i].x;		 v[i]  = uv[i].y;		  w[i]	= uv[i].z;
+			px[i] = p[start+i].x; py[i] = p[start+i].y; pz[i] = p[start+i].z;
+		}
+		batch.count = cnt;
+		if (interleaved){
+			Sample(batch, false, true, out + (Int)start*cc, true);
+		}else{
+			Sample(batch, false, true, tmp.GetFirst(), false);
+			for (Int32 c=0; c<cc; ++c){
+				for (Int32 i=0; i<cnt; ++i) out[(Int)c*count + start + i] = tmp[(Int)c*cnt + i];
+			}
+		}
+	}
+}
+
+#endif//_SAMPLER_MULTI_REMO_H_
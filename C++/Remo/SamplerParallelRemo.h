@@ -0,0 +1,424 @@
+// ------------------------------------------------------------------------------------------------
+// SamplerParallelRemo.h
+// Parallel ShaderSampler For C4D
+// Copyright (c) 2003 - 2014 Remotion(Igor Schulz)  http://www.remotion4d.net
+// 
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose, 
+// including commercial applications, and to alter it and redistribute it freely, 
+// subject to the following restrictions:
+// 
+// 1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. 
+// If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+// ------------------------------------------------------------------------------------------------
+#pragma once
+#ifndef _SAMPLER_PARALLEL_REMO_H_
+#define _SAMPLER_PARALLEL_REMO_H_
+//=================================================================================================
+//	Runs Sampler work on all cores.
+//	Every thread gets its own Sampler created with Sampler::InitClone(),
+//	so the shader is initialized only once and shared by all threads.
+//=================================================================================================
+//   Sampler smpl;
+//   if(smpl.Init(mat,CHANNEL_COLOR, 0.0, doc) != INIT_SAMPLER_RESULT_OK) return FALSE;
+//   ParallelSampler psmpl;
+//   if(!psmpl.Init(smpl)) return FALSE;
+//   SamplerBatch batch;
+//   ... //set here batch.count, batch.u, batch.v, batch.r, batch.g, batch.b !!!
+//   psmpl.SampleUV(batch);
+//=================================================================================================
+#include "c4d_thread.h"
+#include "SamplerRemo.h"
+
+//=================================================================================================
+// Work for ParallelSampler::Run(), Run() is called from many threads at once with
+// the Sampler of the calling thread and a range [start, end) of the work items.
+//=================================================================================================
+class ParallelSamplerJob
+{
+public:
+	virtual ~ParallelSamplerJob() {}
+	virtual void Run(Sampler &smpl, Int32 thread, Int32 start, Int32 end) = 0;
+};
+
+//=================================================================================================
+class ParallelSampler
+//=================================================================================================
+{
+public:
+	ParallelSampler();
+	~ParallelSampler();
+
+	//create per thread samplers from smpl, threads <= 0 means one per core.
+	//smpl must stay initialized until Free() is called.
+	Bool Init(const Sampler &smpl, Int32 threads = 0);
+	void Free();
+
+	Int32	 GetThreadCount() const { return (Int32)samplers.GetCount(); }
+	Sampler* GetSampler(Int32 thread) { return samplers[thread]; }
+
+	//sum of the stats of all per thread samplers, sampleTime adds up the time of all threads.
+	SamplerStats GetStats() const;
+
+	//split count work items into tiles of tile_size and run job for them on all threads.
+	//return false if parent was stopped before all tiles were done.
+	Bool Run(ParallelSamplerJob &job, Int32 count, Int32 tile_size = DEFAULT_TILE, BaseThread *parent = nullptr);
+
+	//same as Sampler::SampleUV/Sample3D(const SamplerBatch&) but on all threads.
+	Bool SampleUV(const SamplerBatch &batch, BaseThread *parent = nullptr);
+	Bool Sample3D(const SamplerBatch &batch, BaseThread *parent = nullptr);
+
+	//number of samples per tile, small enough to balance the threads, big enough to keep the locking cheap.
+	static const Int32 DEFAULT_TILE = 4096;
+
+private:
+	class Worker;
+	class BatchJob;
+
+	Bool FetchTile(Int32 &start, Int32 &end);
+
+	maxon::BaseArray<Sampler*>	samplers; //Owning ptrs
+
+	GeSpinlock	lock;
+	Int32		next;
+	Int32		count;
+	Int32		tile;
+};
+//-------------------------------------------------------------------------------------------------
+class ParallelSampler::Worker : public C4DThread
+{
+public:
+	Worker() : owner(nullptr), job(nullptr), thread(0) {}
+
+	virtual void Main()
+	{
+		Sampler &smpl = *owner->samplers[thread];
+		Int32 start, end;
+		while (!TestBreak() && owner->FetchTile(start, end)){
+			job->Run(smpl, thread, start, end);
+		}
+	}
+	virtual const Char* GetThreadName() { return "ParallelSampler"; }
+
+	ParallelSampler		*owner;
+	ParallelSamplerJob	*job;
+	Int32				 thread;
+};
+//-------------------------------------------------------------------------------------------------
+class ParallelSampler::BatchJob : public ParallelSamplerJob
+{
+public:
+	BatchJob(const SamplerBatch &b, Bool use3d_) : batch(b), use3d(use3d_) {}
+
+	virtual void Run(Sampler &smpl, Int32 thread, Int32 start, Int32 end)
+	{
+		SamplerBatch sub = batch;
+		sub.count = end - start;
+		if (sub.px) sub.px += start;
+		if (sub.py) sub.py += start;
+		if (sub.pz) sub.pz += start;
+		if (sub.u)  sub.u  += start;
+		if (sub.v)  sub.v  += start;
+		if (sub.w)  sub.w  += start;
+		if (sub.t)  sub.t  += start;
+		if (sub.r)  sub.r  += start;
+		if (sub.g)  sub.g  += start;
+		if (sub.b)  sub.b  += start;
+		if (use3d) smpl.Sample3D(sub);
+		else	   smpl.SampleUV(sub);
+	}
+
+	const SamplerBatch &batch;
+	Bool				use3d;
+};
+//-------------------------------------------------------------------------------------------------
+inline ParallelSampler::ParallelSampler()
+{
+	next  = 0;
+	count = 0;
+	tile  = DEFAULT_TILE;
+}
+//-------------------------------------------------------------------------------------------------
+inline ParallelSampler::~ParallelSampler()
+{
+	Free();
+}
+//-------------------------------------------------------------------------------------------------
+inline void ParallelSampler::Free()
+{
+	for (Int32 i=0; i<samplers.GetCount(); ++i){
+		DeleteObj(samplers[i]);
+	}
+	samplers.Flush();
+}
+//-------------------------------------------------------------------------------------------------
+inline Bool ParallelSampler::Init(const Sampler &smpl, Int32 threads)
+{
+	Free();
+	if (threads <= 0) threads = GeGetCurrentThreadCount();
+	if (threads <= 0) threads = 1;
+	for (Int32 i=0; i<threads; ++i){
+		Sampler *clone = NewObj(Sampler);
+		if (!clone) { Free(); return false; }
+		if (!samplers.Append(clone)) { DeleteObj(clone); Free(); return false; }
+		if (clone->InitClone(smpl) != INIT_SAMPLER_RESULT_OK) { Free(); return false; }
+	}
+	return true;
+}
+//-------------------------------------------------------------------------------------------------
+inline SamplerStats ParallelSampler::GetStats() const
+{
+	SamplerStats sum;
+	for (Int32 i=0; i<samplers.GetCount(); ++i){
+		const SamplerStats &st = samplers[i]->GetStats();
+		sum.inits		+= st.inits;
+		sum.reuses		+= st.reuses;
+		sum.samples		+= st.samples;
+		sum.initTime	+= st.initTime;
+		sum.sampleTime	+= st.sampleTime;
+	}
+	return sum;
+}
+//-------------------------------------------------------------------------------------------------
+inline Bool ParallelSampler::FetchTile(Int32 &start, Int32 &end)
+{
+	lock.Lock();
+	start = next;
+	if (next < count) next = (count - next > tile) ? next + tile : count;
+	end	  = next;
+	lock.Unlock();
+	return start < end;
+}
+//-------------------------------------------------------------------------------------------------
+inline Bool ParallelSampler::Run(ParallelSamplerJob &job, Int32 cnt, Int32 tile_size, BaseThread *parent)
+{
+	const Int32 threads = GetThreadCount();
+	if (threads <= 0) return false;
+	if (cnt <= 0) return true;
+	if (tile_size < 1) tile_size = 1;
+
+	next  = 0;
+	count = cnt;
+	tile  = tile_size;
+
+	//no point in starting more threads than tiles.
+	const Int32 tiles = (cnt - 1) / tile_size + 1;
+	const Int32 used  = Min(threads, tiles);
+	if (used > 1){
+		maxon::BaseArray<Worker*>	 workers; //Owning ptrs
+		maxon::BaseArray<C4DThread*> list;
+		Bool ok = workers.Resize(used) && list.Resize(used);
+		for (Int32 i=0; i<used && ok; ++i){
+			workers[i] = NewObj(Worker);
+			if (!workers[i]) { ok = false; break; }
+			workers[i]->owner  = this;
+			workers[i]->job	   = &job;
+			workers[i]->thread = i;
+			list[i]			   = workers[i];
+		}
+		if (ok){
+			MPThreadPool pool;
+			if (pool.Init(parent, used, list.GetFirst()) && pool.Start(THREADPRIORITY_NORMAL)){
+				pool.Wait();
+			}
+		}
+		for (Int32 i=0; i<workers.GetCount(); ++i){
+			DeleteObj(workers[i]);
+		}
+	}
+
+	//whatever was not handed out, because no threads were started or they were stopped, is done here.
+	Int32 start, end;
+	while (!(parent && parent->TestBreak()) && FetchTile(start, end)){
+		job.Run(*samplers[0], 0, start, end);
+	}
+	return !FetchTile(start, end);
+}
+//-------------------------------------------------------------------------------------------------
+inline Bool ParallelSampler::SampleUV(const SamplerBatch &batch, BaseThread *parent)
+{
+	BatchJob job(batch, false);
+	return Run(job, batch.count, DEFAULT_TILE, parent);
+}
+//-------------------------------------------------------------------------------------------------
+inline Bool ParallelSampler::Sample3D(const SamplerBatch &batch, BaseThread *parent)
+{
+	BatchJob job(batch, true);
+	return Run(job, batch.count, DEFAULT_TILE, parent);
+}
+
+//=================================================================================================
+// Vertex color baking
+//=================================================================================================
+enum BAKE_RESULT
+{
+	BAKE_RESULT_OK = 0,
+	BAKE_RESULT_WRONG_PARAM = -1,
+	BAKE_RESULT_NOT_POLYGON = -11,
+	BAKE_RESULT_WRONG_UVW_COUNT = -13,
+	BAKE_RESULT_OUT_OF_MEMORY = -14,
+	BAKE_RESULT_BREAK = -15,
+	BAKE_RESULT_WRITE_ERROR = -16,
+
+} ENUM_END_LIST(BAKE_RESULT);
+
+//-------------------------------------------------------------------------------------------------
+class VertexBakeJob : public ParallelSamplerJob
+{
+public:
+	VertexBakeJob() : padr(nullptr), uvs(nullptr), unique(nullptr), project(false), colors(nullptr), tile(0) {}
+
+	//allocate the arrays of every thread for tiles of at most tile_size points, must be called before ParallelSampler::Run().
+	Bool Init(Int32 threads, Int32 tile_size)
+	{
+		tile = tile_size;
+		if (!buf.Resize((Int)threads*tile*9)) return false;
+		if (project && !pts.Resize((Int)threads*tile*2)) return false;
+		return true;
+	}
+
+	//every work item is one unique point, the batch for a tile is gathered into thread local arrays.
+	virtual void Run(Sampler &smpl, Int32 thread, Int32 start, Int32 end)
+	{
+		const Int32 cnt = end - start;
+		Float *px = &buf[(Int)thread*tile*9], *py = px+cnt, *pz = py+cnt, *u = pz+cnt, *v = u+cnt, *w = v+cnt, *r = w+cnt, *g = r+cnt, *b = g+cnt;
+
+		if (project){
+			Vector *p = &pts[(Int)thread*tile*2], *uv = p+cnt;
+			for (Int32 i=0; i<cnt; ++i) p[i] = padr[unique[start+i]];
+			smpl.ProjectPoints(p, nullptr, cnt, uv);
+			for (Int32 i=0; i<cnt; ++i){ u[i] = uv[i].x; v[i] = uv[i].y; w[i] = uv[i].z; }
+		}else{
+			for (Int32 i=0; i<cnt; ++i){
+				const Vector &uv = uvs[unique[start+i]];
+				u[i] = uv.x; v[i] = uv.y; w[i] = uv.z;
+			}
+		}
+		for (Int32 i=0; i<cnt; ++i){
+			const Vector &p = padr[unique[start+i]];
+			px[i] = p.x; py[i] = p.y; pz[i] = p.z;
+		}
+
+		SamplerBatch batch;
+		batch.count = cnt;
+		batch.px = px; batch.py = py; batch.pz = pz;
+		batch.u  = u;  batch.v	= v;  batch.w  = w;
+		batch.r  = r;  batch.g	= g;  batch.b  = b;
+		smpl.Sample3D(batch);
+
+		for (Int32 i=0; i<cnt; ++i){
+			colors[unique[start+i]] = Vector(r[i],g[i],b[i]);
+		}
+	}
+
+	const Vector *padr;
+	const Vector *uvs;		//uvw per point, unused if project is true.
+	const Int32	 *unique;	//points to sample.
+	Bool		  project;	//no UVW tag, use Sampler::ProjectPoints.
+	Vector		 *colors;
+
+private:
+	Int32					 tile;
+	maxon::BaseArray<Float>	 buf; //9 floats per point of a tile, one tile per thread.
+	maxon::BaseArray<Vector> pts; //2 vectors per point of a tile, one tile per thread.
+};
+//-------------------------------------------------------------------------------------------------
+//sample the color of every point of obj that is used by a polygon, using smpl (initialized by the caller).
+//Every point is sampled only once with the uvw of the first polygon that uses it, taken from the
+//UVW tag of obj or from Sampler::ProjectPoints if obj has none. The unique points are sampled on all threads.
+//colors must hold obj->GetPointCount() elements, points that were not sampled keep their color.
+//sampled may be nullptr, otherwise it must hold obj->GetPointCount() elements and receives which points were sampled
+//if BAKE_RESULT_OK is returned.
+inline BAKE_RESULT BakeVertexColors(BaseObject *obj, Sampler &smpl, Vector *colors, Bool *sampled = nullptr, Int32 threads = 0, BaseThread *parent = nullptr)
+{
+	if (!obj || !colors || !smpl.IsInit()) return BAKE_RESULT_WRONG_PARAM;
+	if (!obj->IsInstanceOf(Opolygon)) return BAKE_RESULT_NOT_POLYGON;
+	PolygonObject *polyo = ToPoly(obj);
+
+	const Int32		pcnt = polyo->GetPointCount();
+	const Vector   *padr = polyo->GetPointR();
+	const Int32		vcnt = polyo->GetPolygonCount();
+	const CPolygon *vadr = polyo->GetPolygonR();
+	if (pcnt <= 0) return BAKE_RESULT_OK;
+
+	UVWTag *uvw_tag = (UVWTag*)polyo->GetTag(Tuvw);
+	ConstUVWHandle uv_handle = nullptr;
+	if (uvw_tag){
+		if (uvw_tag->GetDataCount() != vcnt) return BAKE_RESULT_WRONG_UVW_COUNT;
+		uv_handle = uvw_tag->GetDataAddressR();
+	}
+
+	//one pass over the polygons to find the unique points and their uvw.
+	maxon::BaseArray<Bool>	 used;
+	maxon::BaseArray<Vector> uvs;
+	maxon::BaseArray<Int32>	 unique;
+	if (!used.Resize(pcnt)) return BAKE_RESULT_OUT_OF_MEMORY;
+	if (uv_handle && !uvs.Resize(pcnt)) return BAKE_RESULT_OUT_OF_MEMORY;
+	if (!unique.EnsureCapacity(pcnt)) return BAKE_RESULT_OUT_OF_MEMORY;
+	for (Int32 i=0; i<pcnt; ++i) used[i] = false;
+
+	UVWStruct uvw;
+	for (Int32 c=0; c<vcnt; ++c){
+		const CPolygon &cp = vadr[c];
+		const Int32 idx[4]	= { cp.a, cp.b, cp.c, cp.d };
+		const Int32 corners = (cp.c!=cp.d) ? 4 : 3;
+		if (uv_handle) UVWTag::Get(uv_handle,c,uvw);
+		const Vector *uvwp[4] = { &uvw.a, &uvw.b, &uvw.c, &uvw.d };
+		for (Int32 k=0; k<corners; ++k){
+			const Int32 p = idx[k];
+			if (p < 0 || p >= pcnt || used[p]) continue;
+			used[p] = true;
+			if (uv_handle) uvs[p] = *uvwp[k];
+			unique.Append(p);
+		}
+	}
+	const Int32 ucnt = (Int32)unique.GetCount();
+	if (ucnt){
+		ParallelSampler psmpl;
+		if (!psmpl.Init(smpl, threads)) return BAKE_RESULT_OUT_OF_MEMORY;
+
+		const Int32 tile = Min(ucnt, ParallelSampler::DEFAULT_TILE);
+		VertexBakeJob job;
+		job.padr	= padr;
+		job.uvs		= uv_handle ? uvs.GetFirst() : nullptr;
+		job.unique	= unique.GetFirst();
+		job.project = (uv_handle == nullptr);
+		job.colors	= colors;
+		if (!job.Init(psmpl.GetThreadCount(), tile)) return BAKE_RESULT_OUT_OF_MEMORY;
+		if (!psmpl.Run(job, ucnt, tile, parent)) return BAKE_RESULT_BREAK;
+	}
+	if (sampled) for (Int32 i=0; i<pcnt; ++i) sampled[i] = used[i];
+	return BAKE_RESULT_OK;
+}
+//-------------------------------------------------------------------------------------------------
+//same as BakeVertexColors but writes into a vertex map tag of obj.
+//component 0, 1 or 2 writes the red, green or blue channel, -1 writes the luminance, values are clamped to [0,1].
+inline BAKE_RESULT BakeVertexMap(BaseObject *obj, Sampler &smpl, VertexMapTag *tag, Int32 component = -1, Int32 threads = 0, BaseThread *parent = nullptr)
+{
+	if (!obj || !tag || component < -1 || component > 2) return BAKE_RESULT_WRONG_PARAM;
+	if (!obj->IsInstanceOf(Opolygon)) return BAKE_RESULT_NOT_POLYGON;
+	const Int32 pcnt = ToPoly(obj)->GetPointCount();
+	if (tag->GetDataCount() != pcnt) return BAKE_RESULT_WRONG_PARAM;
+	Float32 *weights = tag->GetDataAddressW();
+	if (!weights) return BAKE_RESULT_WRONG_PARAM;
+
+	maxon::BaseArray<Vector> colors;
+	maxon::BaseArray<Bool>	 sampled;
+	if (!colors.Resize(pcnt) || !sampled.Resize(pcnt)) return BAKE_RESULT_OUT_OF_MEMORY;
+	const BAKE_RESULT res = BakeVertexColors(obj, smpl, colors.GetFirst(), sampled.GetFirst(), threads, parent);
+	if (res != BAKE_RESULT_OK) return res;
+
+	for (Int32 i=0; i<pcnt; ++i){
+		if (!sampled[i]) continue;
+		const Vector &col = colors[i];
+		const Float val = (component == 0) ? col.x : (component == 1) ? col.y : (component == 2) ? col.z
+						: col.x*0.299 + col.y*0.587 + col.z*0.114;
+		weights[i] = (Float32)FCut(val, 0.0, 1.0);
+	}
+	return BAKE_RESULT_OK;
+}
+
+#endif//_SAMPLER_PARALLEL_REMO_H_
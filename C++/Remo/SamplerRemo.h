@@ -47,6 +47,49 @@ enum INIT_SAMPLER_RESULT
 
 } ENUM_END_LIST(INIT_SAMPLER_RESULT);
 
+//=================================================================================================
+// Structure of arrays for batch sampling, see Sampler::SampleUV(const SamplerBatch&).
+// Input arrays that are not needed may be nullptr, all used arrays must hold count elements.
+//=================================================================================================
+struct SamplerBatch
+{
+	SamplerBatch() : count(0), px(nullptr), py(nullptr), pz(nullptr), u(nullptr), v(nullptr), w(nullptr), t(nullptr), time(0.0), r(nullptr), g(nullptr), b(nullptr) {}
+
+	Int32		 count;
+	const Float *px, *py, *pz;	//3D coordinates, only used by Sample3D.
+	const Float *u, *v, *w;		//UVW coordinates, w == nullptr means 0.0.
+	const Float *t;				//time per sample, t == nullptr means time.
+	Float		 time;
+	Float		*r, *g, *b;		//output colors.
+};
+
+//=================================================================================================
+// Maps surface points to UVW coordinates for the P_UVW projection, see Sampler::SetUVWLookup()
+// and UVWTree in SamplerUVWRemo.h.
+//=================================================================================================
+class SamplerUVWLookup
+{
+public:
+	virtual ~SamplerUVWLookup() {}
+
+	//return uvw at the surface point p (object space), false if there is no surface.
+	virtual Bool GetUVW(const Vector &p, Vector *uv) const = 0;
+};
+
+//=================================================================================================
+// Timing counters of a Sampler, see Sampler::GetStats().
+//=================================================================================================
+struct SamplerStats
+{
+	SamplerStats() : inits(0), reuses(0), samples(0), initTime(0.0), sampleTime(0.0) {}
+
+	Int32	inits;		//Init calls that called InitRender.
+	Int32	reuses;		//Init calls that kept the shader initialized (persistent mode).
+	Int64	samples;	//samples taken by the batch functions.
+	Float	initTime;	//milliseconds spent in Init.
+	Float	sampleTime; //milliseconds spent in the batch functions, single SampleUV/Sample3D calls are not timed.
+};
+
 //=================================================================================================
 class Sampler
 //=================================================================================================
@@ -60,22 +103,60 @@ public:
 	INIT_SAMPLER_RESULT Init(BaseMaterial *mat ,Int32 chnr,Float time,BaseDocument *doc,BaseObject *op=nullptr);
 	INIT_SAMPLER_RESULT Init(TextureTag *textag,Int32 chnr,Float time,BaseDocument *doc,BaseObject *op=nullptr);
 
+	//init this sampler as a per thread copy of src, src must be initialized and stay initialized while this is used.
+	//The shader InitRender of src is shared, only VolumeData/ChannelData/TexData/RayObject are copied.
+	INIT_SAMPLER_RESULT InitClone(const Sampler &src);
+
 	//return true if Init was called before.
 	inline Bool IsInit(){ return TexInit; };
+
+	//in persistent mode Init keeps the shader initialized if material, channel, shader and document are the same
+	//and neither material nor shader are dirty since the last InitRender, useful if only time changes between frames.
+	void SetPersistent(Bool on) { persistent = on; }
+	Bool IsPersistent() const { return persistent; }
+
+	const SamplerStats& GetStats() const { return stats; }
+	void ResetStats() { stats = SamplerStats(); }
 	
 	//return color at UVW coordinates.
 	Vector	SampleUV(const Vector &uv, Float time=0.0);
 	
 	//return color at 3D coordinates p, if shader is not 3D then uv will be used.
 	Vector	Sample3D(const Vector &pos3d, const Vector &uv = Vector(0.0), Float time=0.0);
+
+	//sample batch.count points at once, same results as calling SampleUV/Sample3D for every point.
+	void	SampleUV(const SamplerBatch &batch);
+	void	Sample3D(const SamplerBatch &batch);
+
+	//sample batch at shader uv, without the offset/length transform of SampleUV, 3D coordinates are used if given.
+	void	SampleShader(const SamplerBatch &batch);
  
 	//return average color of the shader
 	Vector AverageColor(Int32 num_samples = 128);
 
+	//return average color of the shader using a low-discrepancy sequence, sampling stops as soon as the
+	//95% confidence interval of every color component is below tolerance, max_samples were taken or
+	//time_budget (in milliseconds, 0.0 means no limit) is used up. samples_used may be nullptr.
+	Vector AverageColorProgressive(Float tolerance = 0.005, Int32 max_samples = 4096, Float time_budget = 0.0, Int32 *samples_used = nullptr);
+
 	Bool ProjectPoint(const Vector &p, const Vector &n, Vector *uv);
 
+	//project count points at once, same as calling ProjectPoint for every point.
+	//n may be nullptr then Vector(0,1,0) is used, inside may be nullptr.
+	//tolerance > 0.0 allows faster ACos/ATan approximations as long as the uv error stays below tolerance.
+	//return number of points for which ProjectPoint would return true.
+	Int32 ProjectPoints(const Vector *p, const Vector *n, Int32 count, Vector *uv, Bool *inside = nullptr, Float tolerance = 0.0);
+
 	VolumeData* GetVolumeData() { return vd; }
 	TexData*    GetTexData() { return tex; }
+	BaseShader* GetShader() { return texShader; }
+
+	//used by ProjectPoint/ProjectPoints for P_UVW, without it P_UVW leaves uv unchanged.
+	void SetUVWLookup(const SamplerUVWLookup *lookup) { uvwLookup = lookup; }
+
+	//uv transform used by SampleUV, shader uv = (uv - offset) / length.
+	Vector GetUVOffset() const { return Vector(offsetX,offsetY,0.0); }
+	Vector GetUVLength() const { return Vector(lenX,lenY,1.0); }
  
 	void Free();
 private:
@@ -93,6 +174,24 @@ private:
 	Float			lenX;
 	Float			lenY;
 	Bool			TexInit;
+	Bool			OwnRender; //false for clones, they must not call FreeRender.
+	const SamplerUVWLookup *uvwLookup; //NON owning ptr
+
+	//state of the last InitRender, used by the persistent mode.
+	Bool			persistent;
+	BaseMaterial   *initMat; //NON owning ptr
+	BaseDocument   *initDoc; //NON owning ptr
+	Int32			initChannel;
+	UInt32			initMatDirty;
+	UInt32			initShaderDirty;
+	SamplerStats	stats;
+
+	//number of points transformed at once by the batch functions.
+	static const Int32 BATCH_BLOCK = 256;
+
+	void	SampleBatch(const SamplerBatch &batch, Bool transform, Bool use3d);
+	void	SetObject(BaseObject *op);
+	Bool	IsWarm(BaseMaterial *mat, Int32 chnr, BaseDocument *doc);
 };
 //-------------------------------------------------------------------------------------------------
 inline Vector Sampler::SampleUV(const Vector &uv, Float time)
@@ -112,6 +211,65 @@ inline Vector Sampler::Sample3D(const Vector &p, const Vector &uv, Float time)
 	cd.p			= uv;
 	return texShader->Sample(&cd);
 }
+//-------------------------------------------------------------------------------------------------
+inline void Sampler::SampleUV(const SamplerBatch &batch)
+{
+	SampleBatch(batch, true, false);
+}
+//-------------------------------------------------------------------------------------------------
+inline void Sampler::Sample3D(const SamplerBatch &batch)
+{
+	if (!batch.px || !batch.py || !batch.pz) return;
+	SampleBatch(batch, false, true);
+}
+//-------------------------------------------------------------------------------------------------
+inline void Sampler::SampleShader(const SamplerBatch &batch)
+{
+	SampleBatch(batch, false, batch.px && batch.py && batch.pz);
+}
+//-------------------------------------------------------------------------------------------------
+inline void Sampler::SampleBatch(const SamplerBatch &batch, Bool transform, Bool use3d)
+{
+	if (!batch.u || !batch.v || !batch.r || !batch.g || !batch.b) return;
+	const Float start_time = GeGetMilliSeconds();
+
+	//the offset/length transform is done for a whole block first in plain loops the compiler can vectorize,
+	//then the shader is called once per point with only the changing ChannelData members set.
+	Float bu[BATCH_BLOCK];
+	Float bv[BATCH_BLOCK];
+	const Float ox = transform ? offsetX : 0.0;
+	const Float oy = transform ? offsetY : 0.0;
+	const Float lx = transform ? lenX : 1.0;
+	const Float ly = transform ? lenY : 1.0;
+
+	cd.t = batch.time;
+	for (Int32 start=0; start < batch.count; start += BATCH_BLOCK){
+		const Int32  cnt = Min(BATCH_BLOCK, batch.count - start);
+		const Float *u	 = batch.u + start;
+		const Float *v	 = batch.v + start;
+		for (Int32 i=0; i<cnt; ++i) bu[i] = (u[i]-ox) / lx;
+		for (Int32 i=0; i<cnt; ++i) bv[i] = (v[i]-oy) / ly;
+
+		for (Int32 i=0; i<cnt; ++i){
+			const Int32 k = start + i;
+			if (batch.t) cd.t = batch.t[k];
+			cd.p.x = bu[i];
+			cd.p.y = bv[i];
+			cd.p.z = batch.w ? batch.w[k] : 0.0;
+			if (use3d){
+				cd.vd->p.x = cd.vd->back_p.x = batch.px[k];
+				cd.vd->p.y = cd.vd->back_p.y = batch.py[k];
+				cd.vd->p.z = cd.vd->back_p.z = batch.pz[k];
+			}
+			const Vector col = texShader->Sample(&cd);
+			batch.r[k] = col.x;
+			batch.g[k] = col.y;
+			batch.b[k] = col.z;
+		}
+	}
+	stats.samples	 += batch.count;
+	stats.sampleTime += GeGetMilliSeconds() - start_time;
+}
 // ----------------------------------------------------------------------------------------------------
 inline Bool ReadTextureTag(TextureTag *textag, TexData *tex)
 {	
@@ -168,26 +326,22 @@ inline INIT_SAMPLER_RESULT Sampler::Init(BaseMaterial *mat,Int32 chnr, Float tim
 {
 	if (!mat || !doc || chnr < 0 || chnr > 12)	return INIT_SAMPLER_RESULT_WRONG_PARAM;
 	if (!cd.vd	|| !tex || !rop) return INIT_SAMPLER_RESULT_WRONG_PARAM;
-	TexInit = FALSE;
+	const Float start_time = GeGetMilliSeconds();
+	if (IsWarm(mat,chnr,doc)){
+		if (op) SetObject(op);
+		tex->mp = mat;
+		stats.reuses++;
+		stats.initTime += GeGetMilliSeconds() - start_time;
+		return INIT_SAMPLER_RESULT_OK;
+	}
+	Free(); //release the InitRender of a previous Init.
 	INIT_SAMPLER_RESULT	 err = INIT_SAMPLER_RESULT_OK;
 	BaseContainer	chandata;
 	Int32			fps		= doc->GetFps();
 	Filename		dpath	= doc->GetDocumentPath();
 	BaseChannel	*texChan1   = mat->GetChannel(chnr); if (!texChan1) return INIT_SAMPLER_RESULT_NO_CHANNEL;//no Channel
 	texShader = texChan1->GetShader(); 	if(!texShader) return INIT_SAMPLER_RESULT_NO_SHADER;
-	if (op){ //Object
-		rop->link		= op;
-		rop->mg			= op->GetMg();
-		rop->mp			= op->GetMg() * op->GetMp();
-		rop->rad		= op->GetRad();
-		if (op->IsInstanceOf(Opolygon)){
-			rop->pcnt	= ToPoly(op)->GetPointCount();
-			rop->padr	= ToPoly(op)->GetPointW();
-			rop->vcnt	= ToPoly(op)->GetPolygonCount();
-			rop->vadr	= (RayPolygon*)ToPoly(op)->GetPolygonW();
-			rop->type   = O_POLYGON;
-		}
-	}
+	if (op) SetObject(op);
 	//----------------- TexData -------------------
 	tex->mp			= mat;// Set Material
 	//------------ InitRenderStruct ----------------
@@ -204,8 +358,17 @@ inline INIT_SAMPLER_RESULT Sampler::Init(BaseMaterial *mat,Int32 chnr, Float tim
 	cd.d		= Vector(0.0);
 	cd.n		= Vector(0.0,1.0,0.0);
 	cd.texflag	= TEX_TILE;
-	if (texShader->InitRender(irs)==INITRENDERRESULT_OK) { 
+	const INITRENDERRESULT init_res = texShader->InitRender(irs);
+	stats.inits++;
+	stats.initTime += GeGetMilliSeconds() - start_time;
+	if (init_res==INITRENDERRESULT_OK) { 
 		TexInit = TRUE;
+		OwnRender = TRUE;
+		initMat			= mat;
+		initDoc			= doc;
+		initChannel		= chnr;
+		initMatDirty	= mat->GetDirty(DIRTYFLAGS_DATA);
+		initShaderDirty = texShader->GetDirty(DIRTYFLAGS_DATA);
 		return INIT_SAMPLER_RESULT_OK; //OK
 	}else{ 
 		err = INIT_SAMPLER_RESULT_NO_INITRENDER;
@@ -214,10 +377,87 @@ inline INIT_SAMPLER_RESULT Sampler::Init(BaseMaterial *mat,Int32 chnr, Float tim
 	return err;
 }
 //-------------------------------------------------------------------------------------------------
+inline Bool Sampler::IsWarm(BaseMaterial *mat, Int32 chnr, BaseDocument *doc)
+{
+	if (!persistent || !TexInit || !OwnRender) return false;
+	if (mat != initMat || chnr != initChannel || doc != initDoc) return false;
+	BaseChannel *chan = mat->GetChannel(chnr);
+	if (!chan || chan->GetShader() != texShader) return false;
+	return mat->GetDirty(DIRTYFLAGS_DATA) == initMatDirty && texShader->GetDirty(DIRTYFLAGS_DATA) == initShaderDirty;
+}
+//-------------------------------------------------------------------------------------------------
+inline void Sampler::SetObject(BaseObject *op)
+{
+	rop->link		= op;
+	rop->mg			= op->GetMg();
+	rop->mp			= op->GetMg() * op->GetMp();
+	rop->rad		= op->GetRad();
+	//clear the polygon data of a previous object, in persistent mode it may be freed already.
+	rop->pcnt		= 0;
+	rop->padr		= nullptr;
+	rop->vcnt		= 0;
+	rop->vadr		= nullptr;
+	rop->type		= O_SPHERE;
+	if (op->IsInstanceOf(Opolygon)){
+		rop->pcnt	= ToPoly(op)->GetPointCount();
+		rop->padr	= ToPoly(op)->GetPointW();
+		rop->vcnt	= ToPoly(op)->GetPolygonCount();
+		rop->vadr	= (RayPolygon*)ToPoly(op)->GetPolygonW();
+		rop->type   = O_POLYGON;
+	}
+}
+//-------------------------------------------------------------------------------------------------
+inline INIT_SAMPLER_RESULT Sampler::InitClone(const Sampler &src)
+{
+	if (this == &src || !src.TexInit || !src.texShader) return INIT_SAMPLER_RESULT_WRONG_PARAM;
+	if (!cd.vd	|| !tex || !rop) return INIT_SAMPLER_RESULT_WRONG_PARAM;
+	Free();
+	texShader	= src.texShader;
+	omg			= src.omg;
+	offsetX		= src.offsetX;
+	offsetY		= src.offsetY;
+	lenX		= src.lenX;
+	lenY		= src.lenY;
+	uvwLookup	= src.uvwLookup;
+	//----------------- TexData -------------------
+	*tex		= *src.tex;
+	//---------------- RayObject -----------------
+	rop->link		= src.rop->link;
+	rop->mg			= src.rop->mg;
+	rop->mp			= src.rop->mp;
+	rop->rad		= src.rop->rad;
+	rop->pcnt		= src.rop->pcnt;
+	rop->padr		= src.rop->padr;
+	rop->vcnt		= src.rop->vcnt;
+	rop->vadr		= src.rop->vadr;
+	rop->type		= src.rop->type;
+	//------------ InitRenderStruct ----------------
+	irs			= src.irs;
+	irs.vd		= cd.vd;
+	//---------------- Sampling ---------------------
+	cd.t		= src.cd.t;
+	cd.off		= src.cd.off;
+	cd.scale	= src.cd.scale;
+	cd.d		= src.cd.d;
+	cd.n		= src.cd.n;
+	cd.texflag	= src.cd.texflag;
+	TexInit		= TRUE;
+	OwnRender	= FALSE;
+	return INIT_SAMPLER_RESULT_OK;
+}
+//-------------------------------------------------------------------------------------------------
 inline Sampler::Sampler()
 {
 	texShader		= nullptr;
 	TexInit			= FALSE;
+	OwnRender		= TRUE;
+	uvwLookup		= nullptr;
+	persistent		= FALSE;
+	initMat			= nullptr;
+	initDoc			= nullptr;
+	initChannel		= -1;
+	initMatDirty	= 0;
+	initShaderDirty = 0;
 	offsetX			= 1.0;
 	offsetY			= 1.0;
 	lenX			= 1.0;
@@ -275,9 +515,12 @@ inline Sampler::Sampler()
 inline void Sampler::Free()
 {
 	if (texShader){ 
-		if (TexInit){ texShader->FreeRender(); }
+		if (TexInit && OwnRender){ texShader->FreeRender(); }
 	}
 	TexInit = FALSE;
+	OwnRender = TRUE;
+	initMat = nullptr;
+	initDoc = nullptr;
 }
 //-------------------------------------------------------------------------------------------------
 inline Sampler::~Sampler(void)
@@ -303,14 +546,65 @@ inline Vector Sampler::AverageColor(Int32 num_samples)
 		uv = Vector(rnd.Get01(),rnd.Get01(),0.0);
 		pos3d = Vector(rnd.Get11(),rnd.Get11(),rnd.Get11()) * scale3d;
 		const Vector color = Sample3D(pos3d, uv);  
-		ave_color += (color - ave_color) / cnt;
 		cnt += 1.0;
+		ave_color += (color - ave_color) / cnt;
 	}
 	
 	return ave_color;
 }
+//-------------------------------------------------------------------------------------------------
+//radical inverse of index in base, the Halton sequence in [0,1).
+inline Float SamplerHalton(Int32 index, Int32 base)
+{
+	const Float inv = 1.0 / (Float)base;
+	Float f = inv, r = 0.0;
+	while (index > 0){
+		r += f * (Float)(index % base);
+		index /= base;
+		f *= inv;
+	}
+	return r;
+}
+//-------------------------------------------------------------------------------------------------
+inline Vector Sampler::AverageColorProgressive(Float tolerance, Int32 max_samples, Float time_budget, Int32 *samples_used)
+{
+	const Float scale3d		= 50.0;
+	const Int32 min_samples = 16;	//do not trust the variance of fewer samples.
+	const Int32 check_step	= 16;	//samples between two checks of tolerance and time.
+	const Float z95			= 1.96;
+
+	const Float start_time = (time_budget > 0.0) ? GeGetMilliSeconds() : 0.0;
+	Vector mean = Vector(0.0);
+	Vector m2	= Vector(0.0); //sum of squared differences from the mean (Welford).
+	Int32  cnt	= 0;
+
+	while (cnt < max_samples){
+		//index 0 is the origin in every dimension, start at 1.
+		const Int32 k = cnt + 1;
+		const Vector uv(SamplerHalton(k,2), SamplerHalton(k,3), 0.0);
+		const Vector pos3d = Vector(SamplerHalton(k,5)*2.0-1.0, SamplerHalton(k,7)*2.0-1.0, SamplerHalton(k,11)*2.0-1.0) * scale3d;
+		const Vector color = Sample3D(pos3d, uv);
+		++cnt;
+		const Vector delta = color - mean;
+		mean += delta / (Float)cnt;
+		const Vector delta2 = color - mean;
+		m2.x += delta.x*delta2.x;
+		m2.y += delta.y*delta2.y;
+		m2.z += delta.z*delta2.z;
+
+		if (cnt < min_samples || cnt % check_step != 0) continue;
+
+		//half width of the confidence interval is z * sqrt(variance / n).
+		const Float var_n = Max(Max(m2.x, m2.y), m2.z) / ((Float)(cnt-1) * (Float)cnt);
+		if (z95 * Sqrt(var_n) <= tolerance) break;
+		if (time_budget > 0.0 && GeGetMilliSeconds() - start_time >= time_budget) break;
+	}
+
+	if (samples_used) *samples_used = cnt;
+	return mean;
+}
 // ----------------------------------------------------------------------------------------------------
-Bool Sampler::ProjectPoint(const Vector &p, const Vector &n, Vector *uv)
+inline Bool Sampler::ProjectPoint(const Vector &p, const Vector &n, Vector *uv)
 {
 	Float lenxinv=0.0,lenyinv=0.0;
 	if (tex->lenx!=0.0) lenxinv = 1.0/tex->lenx;
@@ -484,14 +778,9 @@ Bool Sampler::ProjectPoint(const Vector &p, const Vector &n, Vector *uv)
 
 	case P_UVW:
 		{
-			/*const RayHitID& lhit,*/ /*Int32 lhit,*/ 
-			/*
-			RayObject *op = lhit.GetObject(vd); //RayObject *op = vd->ID_to_Obj(lhit,nullptr);
-			if (op && tex->uvwind<op->uvwcnt && op->uvwadr[tex->uvwind])
-				*uv=vd->GetPointUVW(tex,lhit,p);
-			else
+			//there is no ray hit to ask the VolumeData for the uvw, so the uvw of the nearest surface point is used.
+			if (uvwLookup && !uvwLookup->GetUVW(p,uv))
 				uv->x = uv->y = 0.0;
-			*/
 			break;
 		}
 	}//switch
@@ -502,13 +791,196 @@ Bool Sampler::ProjectPoint(const Vector &p, const Vector &n, Vector *uv)
 		return uv->x>=0.0 && uv->x<=1.0 && uv->y>=0.0 && uv->y<=1.0;
 }
 
+// ----------------------------------------------------------------------------------------------------
+// Polynomial approximations used by Sampler::ProjectPoints (Abramowitz & Stegun 4.4.45 - 4.4.49).
+// level 0 is exact, level 1 and 2 have an absolute error (in radians) below SAMPLER_APPROX_ERROR[level].
+// ----------------------------------------------------------------------------------------------------
+static const Float SAMPLER_APPROX_ERROR[3] = { 0.0, 7.0e-5, 3.0e-8 };
+
+inline Float SamplerACos(Float x, Int32 level)
+{
+	if (level == 0) return ACos(x);
+	const Float a = Abs(x);
+	Float r;
+	if (level == 1){
+		r = Sqrt(1.0-a) * (1.5707288 + a*(-0.2121144 + a*(0.0742610 + a*(-0.0187293))));
+	}else{
+		r = Sqrt(1.0-a) * (1.5707963050 + a*(-0.2145988016 + a*(0.0889789874 + a*(-0.0501743046
+			+ a*(0.0308918810 + a*(-0.0170881256 + a*(0.0066700901 + a*(-0.0012624911))))))));
+	}
+	return (x < 0.0) ? PI - r : r;
+}
+// ----------------------------------------------------------------------------------------------------
+inline Float SamplerATan(Float x, Int32 level)
+{
+	if (level == 0) return ATan(x);
+	const Bool  inv = Abs(x) > 1.0;
+	const Float a	= inv ? 1.0/x : x;
+	const Float a2	= a*a;
+	Float r;
+	if (level == 1){
+		r = a * (0.9998660 + a2*(-0.3302995 + a2*(0.1801410 + a2*(-0.0851330 + a2*0.0208351))));
+	}else{
+		r = a * (0.9999993329 + a2*(-0.3332985605 + a2*(0.1994653599 + a2*(-0.1390853351 + a2*(0.0964200441
+			+ a2*(-0.0559098861 + a2*(0.0218612288 + a2*(-0.0040540580))))))));
+	}
+	if (inv) r = ((x > 0.0) ? PI05 : -PI05) - r;
+	return r;
+}
+// ----------------------------------------------------------------------------------------------------
+inline Int32 Sampler::ProjectPoints(const Vector *p, const Vector *n, Int32 count, Vector *uv, Bool *inside, Float tolerance)
+{
+	if (!p || !uv || count <= 0) return 0;
+
+	//these are done per point by ProjectPoint and hoisted out of the loops here.
+	Float lenxinv=0.0,lenyinv=0.0;
+	if (tex->lenx!=0.0) lenxinv = 1.0/tex->lenx;
+	if (tex->leny!=0.0) lenyinv = 1.0/tex->leny;
+	const Matrix im = tex->im;
+	const Float  ox = tex->ox;
+	const Float  oy = tex->oy;
+	const Float  lx = tex->lenx;
+
+	//the angle error ends up scaled by at most the larger inverse length in uv.
+	Int32 level = 0;
+	if (tolerance > 0.0){
+		const Float scale = Max(Max(Abs(lenxinv),Abs(lenyinv)), 1.0);
+		if (SAMPLER_APPROX_ERROR[1]*scale <= tolerance) level = 1;
+		else if (SAMPLER_APPROX_ERROR[2]*scale <= tolerance) level = 2;
+	}
+
+	switch (tex->proj)
+	{
+	case P_VOLUMESHADER:
+		{
+			for (Int32 i=0; i<count; ++i) uv[i] = p[i] * im;
+			if (inside) for (Int32 i=0; i<count; ++i) inside[i] = true;
+			return count;
+		}
+
+	case P_SPHERICAL: default:
+		{
+			for (Int32 i=0; i<count; ++i){
+				const Vector d = p[i] * im;
+				const Float sq = Sqrt(d.x*d.x + d.z*d.z);
+				Float x = 0.0, y;
+				if (sq==0.0){
+					y = (d.y>0.0) ? 0.5 : -0.5;
+				}else{
+					x = SamplerACos(d.x/sq,level)/PI2;
+					if (d.z<0.0) x = 1.0-x;
+					x -= ox;
+					if (lx>0.0 && x<0.0)	  x += 1.0;
+					else if (lx<0.0 && x>0.0) x -= 1.0;
+					x *= lenxinv;
+					y = SamplerATan(d.y/sq,level)/PI;
+				}
+				uv[i].x = x;
+				uv[i].y = -(y+oy)*lenyinv;
+			}
+			break;
+		}
+
+	case P_SHRINKWRAP:
+		{
+			for (Int32 i=0; i<count; ++i){
+				const Vector d = p[i] * im;
+				const Float sq = Sqrt(d.x*d.x + d.z*d.z);
+				Float x = 0.0, y, sn, cs;
+				if (sq==0.0){
+					y = (d.y>0.0) ? 0.0 : 1.0;
+				}else{
+					x = SamplerACos(d.x/sq,level)/PI2;
+					if (d.z<0.0) x = 1.0-x;
+					y = 0.5-SamplerATan(d.y/sq,level)/PI;
+				}
+				SinCos(x*PI2,sn,cs);
+				uv[i].x = (0.5 + 0.5*cs*y - ox)*lenxinv;
+				uv[i].y = (0.5 + 0.5*sn*y - oy)*lenyinv;
+			}
+			break;
+		}
+
+	case P_CYLINDRICAL:
+		{
+			for (Int32 i=0; i<count; ++i){
+				const Vector d = p[i] * im;
+				const Float sq = Sqrt(d.x*d.x + d.z*d.z);
+				Float x = 0.0;
+				if (sq!=0.0){
+					x = SamplerACos(d.x/sq,level)/PI2;
+					if (d.z<0.0) x = 1.0-x;
+					x -= ox;
+					if (lx>0.0 && x<0.0)	  x += 1.0;
+					else if (lx<0.0 && x>0.0) x -= 1.0;
+					x *= lenxinv;
+				}
+				uv[i].x = x;
+				uv[i].y = -(d.y*0.5+oy)*lenyinv;
+			}
+			break;
+		}
+
+	case P_FLAT: case P_SPATIAL:
+		{
+			for (Int32 i=0; i<count; ++i){
+				const Vector d = p[i] * im;
+				uv[i].x =  (d.x*0.5-ox)*lenxinv;
+				uv[i].y = -(d.y*0.5+oy)*lenyinv;
+			}
+			break;
+		}
+
+	case P_CUBIC:
+		{
+			const Vector n0(0.0,1.0,0.0);
+			for (Int32 i=0; i<count; ++i){
+				const Vector d = p[i] * im;
+				const Vector v = (n ? n[i] : n0) ^ im;
+				const Float ax = Abs(v.x), ay = Abs(v.y), az = Abs(v.z);
+				if (ax>ay && ax>az){ // x axis
+					uv[i].x = ((v.x<0.0 ? -d.z : d.z)*0.5-ox)*lenxinv;
+					uv[i].y = -(d.y*0.5+oy)*lenyinv;
+				}else if (ax<=ay && ay>az){ // y axis
+					uv[i].y = ((v.y<0.0 ? d.z : -d.z)*0.5-oy)*lenyinv;
+					uv[i].x = (d.x*0.5-ox)*lenxinv;
+				}else{ // z axis
+					uv[i].x = ((v.z<0.0 ? d.x : -d.x)*0.5-ox)*lenxinv;
+					uv[i].y = -(d.y*0.5+oy)*lenyinv;
+				}
+			}
+			break;
+		}
+
+	case P_FRONTAL: case P_UVW:
+		{
+			//these do not depend on the point alone, use the scalar path.
+			const Vector n0(0.0,1.0,0.0);
+			for (Int32 i=0; i<count; ++i) ProjectPoint(p[i], n ? n[i] : n0, &uv[i]);
+			break;
+		}
+	}//switch
+
+	if (tex->texflag&TEX_TILE){
+		if (inside) for (Int32 i=0; i<count; ++i) inside[i] = true;
+		return count;
+	}
+	Int32 cnt = 0;
+	for (Int32 i=0; i<count; ++i){
+		const Bool in = uv[i].x>=0.0 && uv[i].x<=1.0 && uv[i].y>=0.0 && uv[i].y<=1.0;
+		if (inside) inside[i] = in;
+		cnt += in ? 1 : 0;
+	}
+	return cnt;
+}
+
 //#####################################################################################################
 ///					Examples
 //#####################################################################################################
 //#include "C4DPrintPublic.h"
 //#include "c4d_misc.h"
 // ----------------------------------------------------------------------------------------------------
-Int32 SampleColorAtVertices(BaseObject *obj) //Remo: 02.08.2014
+inline Int32 SampleColorAtVertices(BaseObject *obj) //Remo: 02.08.2014
 {
 	if(! obj->IsInstanceOf(Opolygon)) if (!obj) return -11; //Not a polygon Object 
 	PolygonObject *polyo = ToPoly(obj);
@@ -527,7 +999,6 @@ Int32 SampleColorAtVertices(BaseObject *obj) //Remo: 02.08.2014
 		if(uv_cnt != vcnt)  return -13; //Wrong UVS count !
 	}
 
-	Vector n = Vector(0.0,1.0,0.0); //normal
 	Sampler smpl;
 	const INIT_SAMPLER_RESULT init_res = smpl.Init(polyo,CHANNEL_COLOR);
 	if(init_res != INIT_SAMPLER_RESULT_OK) return init_res;
@@ -548,10 +1019,11 @@ Int32 SampleColorAtVertices(BaseObject *obj) //Remo: 02.08.2014
 			uvw_tag->Get(uv_handle,c,uvw); }
 		else{ 
 			//Not really tested code, Please contribute fixes !
-			smpl.ProjectPoint(padr[cp.a],n, &uvw.a); //print(uvw.a);
-			smpl.ProjectPoint(padr[cp.b],n, &uvw.b); //print(uvw.b);
-			smpl.ProjectPoint(padr[cp.c],n, &uvw.c); //print(uvw.c);
-			if(cp.c!=cp.d){ smpl.ProjectPoint(padr[cp.d],n, &uvw.d); }
+			const Vector pts[4] = { padr[cp.a], padr[cp.b], padr[cp.c], padr[cp.d] };
+			Vector uvs[4];
+			smpl.ProjectPoints(pts, nullptr, (cp.c!=cp.d) ? 4 : 3, uvs);
+			uvw.a = uvs[0]; uvw.b = uvs[1]; uvw.c = uvs[2];
+			if(cp.c!=cp.d){ uvw.d = uvs[3]; }
 		}
 		{ //a
 			Colors &ca = colors[cp.a];
@@ -0,0 +1,375 @@
+// ------------------------------------------------------------------------------------------------
+// SamplerUVWRemo.h
+// UVW Lookup For C4D
+// Copyright (c) 2003 - 2014 Remotion(Igor Schulz)  http://www.remotion4d.net
+// 
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose, 
+// including commercial applications, and to alter it and redistribute it freely, 
+// subject to the following restrictions:
+// 
+// 1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. 
+// If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+// ------------------------------------------------------------------------------------------------
+#pragma once
+#ifndef _SAMPLER_UVW_REMO_H_
+#define _SAMPLER_UVW_REMO_H_
+//=================================================================================================
+//	Bounding volume hierarchies over the triangles of a polygon object and its UVW tag.
+//	The 3D tree maps surface points to uvw (nearest triangle), the UV tree maps uvw back
+//	to surface points. Both are built once, queries take logarithmic time.
+//=================================================================================================
+//   UVWTree tree;
+//   if(!tree.Init(polyo)) return FALSE;
+//   Sampler smpl;
+//   if(smpl.Init(polyo,CHANNEL_COLOR) != INIT_SAMPLER_RESULT_OK) return FALSE;
+//   smpl.SetUVWLookup(&tree); //ProjectPoint now handles P_UVW.
+//   Vector uv; tree.PointToUV(p, &uv);
+//=================================================================================================
+#include "SamplerRemo.h"
+
+//=================================================================================================
+class UVWTree : public SamplerUVWLookup
+//=================================================================================================
+{
+public:
+	UVWTree() {}
+	virtual ~UVWTree() { Free(); }
+
+	//build both trees from the points, polygons and UVW tag of obj, uvw_tag == nullptr means the first UVW tag.
+	Bool Init(BaseObject *obj, UVWTag *uvw_tag = nullptr);
+	void Free();
+
+	//return uvw of the surface point nearest to p (object space), poly may be nullptr.
+	Bool PointToUV(const Vector &p, Vector *uv, Int32 *poly = nullptr) const;
+
+	//return surface point (object space) with uvw uv, false if no polygon covers uv, poly may be nullptr.
+	Bool UVToPoint(const Vector &uv, Vector *p, Int32 *poly = nullptr) const;
+
+	//batch versions, return number of successful queries, failed queries are set to Vector(0.0).
+	Int32 PointsToUV(const Vector *p, Int32 count, Vector *uv) const;
+	Int32 UVsToPoint(const Vector *uv, Int32 count, Vector *p) const;
+
+	/* Override: SamplerUVWLookup */
+	virtual Bool GetUVW(const Vector &p, Vector *uv) const { return PointToUV(p, uv); }
+
+	Int32 GetTriangleCount() const { return (Int32)tris.GetCount(); }
+
+	static const Int32 LEAF_SIZE = 4;
+	static const Int32 MAX_DEPTH = 64;
+
+private:
+	struct Triangle
+	{
+		Vector	p[3];	//object space
+		Vector	uv[3];
+		Int32	poly;
+	};
+	struct Node
+	{
+		Vector	min, max;
+		Int32	first;	//first child (inner node) or first triangle index (leaf).
+		Int32	count;	//0 for inner nodes, the children are first and first+1.
+	};
+	struct Tree
+	{
+		maxon::BaseArray<Node>	nodes;
+		maxon::BaseArray<Int32> index; //triangles in leaf order.
+	};
+
+	Bool Build(Tree &tree, Bool use_uv);
+	void Bounds(Int32 t, Bool use_uv, Vector &mn, Vector &mx) const;
+	Vector Center(Int32 t, Bool use_uv) const;
+
+	static Vector ClosestPoint(const Vector &p, const Vector &a, const Vector &b, const Vector &c, Float &u, Float &v, Float &w);
+	static Float  BoxDistance(const Node &n, const Vector &p);
+
+	maxon::BaseArray<Triangle> tris;
+	Tree tree3d;
+	Tree treeUV;
+};
+//-------------------------------------------------------------------------------------------------
+inline void UVWTree::Free()
+{
+	tris.Reset();
+	tree3d.nodes.Reset();
+	tree3d.index.Reset();
+	treeUV.nodes.Reset();
+	treeUV.index.Reset();
+}
+//-------------------------------------------------------------------------------------------------
+inline Bool UVWTree::Init(BaseObject *obj, UVWTag *uvw_tag)
+{
+	Free();
+	if (!obj || !obj->IsInstanceOf(Opolygon)) return false;
+	PolygonObject *polyo = ToPoly(obj);
+	if (!uvw_tag) uvw_tag = (UVWTag*)polyo->GetTag(Tuvw);
+	if (!uvw_tag) return false;
+
+	const Int32		pcnt = polyo->GetPointCount();
+	const Vector   *padr = polyo->GetPointR();
+	const Int32		vcnt = polyo->GetPolygonCount();
+	const CPolygon *vadr = polyo->GetPolygonR();
+	if (uvw_tag->GetDataCount() != vcnt) return false;
+	ConstUVWHandle uv_handle = uvw_tag->GetDataAddressR();
+
+	//quadrangles are split into the triangles a,b,c and a,c,d.
+	if (!tris.EnsureCapacity((Int)vcnt*2)) return false;
+	UVWStruct uvw;
+	for (Int32 c=0; c<vcnt; ++c){
+		const CPolygon &cp = vadr[c];
+		if (cp.a<0 || cp.b<0 || cp.c<0 || cp.d<0 || cp.a>=pcnt || cp.b>=pcnt || cp.c>=pcnt || cp.d>=pcnt) continue;
+		UVWTag::Get(uv_handle,c,uvw);
+		Triangle t;
+		t.poly	= c;
+		t.p[0]	= padr[cp.a]; t.p[1]  = padr[cp.b]; t.p[2]	= padr[cp.c];
+		t.uv[0] = uvw.a;	  t.uv[1] = uvw.b;		t.uv[2] = uvw.c;
+		if (!tris.Append(t)) { Free(); return false; }
+		if (cp.c != cp.d){
+			t.p[1]	= padr[cp.c]; t.p[2]  = padr[cp.d];
+			t.uv[1] = uvw.c;	  t.uv[2] = uvw.d;
+			if (!tris.Append(t)) { Free(); return false; }
+		}
+	}
+	if (!tris.GetCount()) return false;
+	if (!Build(tree3d, false) || !Build(treeUV, true)) { Free(); return false; }
+	return true;
+}
+//-------------------------------------------------------------------------------------------------
+inline void UVWTree::Bounds(Int32 t, Bool use_uv, Vector &mn, Vector &mx) const
+{
+	const Vector *v = use_uv ? tris[t].uv : tris[t].p;
+	mn = mx = v[0];
+	for (Int32 k=1; k<3; ++k){
+		mn.x = Min(mn.x, v[k].x); mn.y = Min(mn.y, v[k].y); mn.z = Min(mn.z, v[k].z);
+		mx.x = Max(mx.x, v[k].x); mx.y = Max(mx.y, v[k].y); mx.z = Max(mx.z, v[k].z);
+	}
+	if (use_uv) mn.z = mx.z = 0.0; //w is ignored by UVToPoint.
+}
+//-------------------------------------------------------------------------------------------------
+inline Vector UVWTree::Center(Int32 t, Bool use_uv) const
+{
+	const Vector *v = use_uv ? tris[t].uv : tris[t].p;
+	Vector c = (v[0] + v[1] + v[2]) * (1.0/3.0);
+	if (use_uv) c.z = 0.0;
+	return c;
+}
+//-------------------------------------------------------------------------------------------------
+inline Bool UVWTree::Build(Tree &tree, Bool use_uv)
+{
+	const Int32 cnt = (Int32)tris.GetCount();
+	if (!tree.index.Resize(cnt)) return false;
+	for (Int32 i=0; i<cnt; ++i) tree.index[i] = i;
+	if (!tree.nodes.EnsureCapacity((Int)cnt*2)) return false;
+
+	//nodes are split at the median of the triangle centers along the longest axis,
+	//the ranges that still have to be split are kept on an explicit stack.
+	struct Range { Int32 node, start, end; };
+	maxon::BaseArray<Range> stack;
+	Node root;
+	root.first = 0;
+	root.count = cnt;
+	if (!tree.nodes.Append(root)) return false;
+	Range r0 = { 0, 0, cnt };
+	if (!stack.Append(r0)) return false;
+
+	Range r;
+	while (stack.Pop(&r)){
+		Vector mn, mx, cmn, cmx, tmn, tmx;
+		Bounds(tree.index[r.start], use_uv, mn, mx);
+		cmn = cmx = Center(tree.index[r.start], use_uv);
+		for (Int32 i=r.start+1; i<r.end; ++i){
+			Bounds(tree.index[i], use_uv, tmn, tmx);
+			mn.x = Min(mn.x, tmn.x); mn.y = Min(mn.y, tmn.y); mn.z = Min(mn.z, tmn.z);
+			mx.x = Max(mx.x, tmx.x); mx.y = Max(mx.y, tmx.y); mx.z = Max(mx.z, tmx.z);
+			const Vector c = Center(tree.index[i], use_uv);
+			cmn.x = Min(cmn.x, c.x); cmn.y = Min(cmn.y, c.y); cmn.z = Min(cmn.z, c.z);
+			cmx.x = Max(cmx.x, c.x); cmx.y = Max(cmx.y, c.y); cmx.z = Max(cmx.z, c.z);
+		}
+		tree.nodes[r.node].min = mn;
+		tree.nodes[r.node].max = mx;
+
+		const Vector ext = cmx - cmn;
+		if (r.end - r.start <= LEAF_SIZE || (ext.x <= 0.0 && ext.y <= 0.0 && ext.z <= 0.0)){
+			tree.nodes[r.node].first = r.start;
+			tree.nodes[r.node].count = r.end - r.start;
+			continue;
+		}
+		const Int32 axis = (ext.x >= ext.y && ext.x >= ext.z) ? 0 : (ext.y >= ext.z ? 1 : 2);
+
+		//quickselect the median along axis.
+		const Int32 mid = (r.start + r.end) / 2;
+		Int32 lo = r.start, hi = r.end - 1;
+		while (lo < hi){
+			const Vector pc = Center(tree.index[(lo + hi) / 2], use_uv);
+			const Float pivot = (axis == 0) ? pc.x : (axis == 1) ? pc.y : pc.z;
+			Int32 i = lo, j = hi;
+			while (i <= j){
+				for (;;) { const Vector c = Center(tree.index[i], use_uv); if (((axis == 0) ? c.x : (axis == 1) ? c.y : c.z) < pivot) ++i; else break; }
+				for (;;) { const Vector c = Center(tree.index[j], use_uv); if (((axis == 0) ? c.x : (axis == 1) ? c.y : c.z) > pivot) --j; else break; }
+				if (i <= j) { Swap(tree.index[i], tree.index[j]); ++i; --j; }
+			}
+			if (mid <= j) hi = j;
+			else if (mid >= i) lo = i;
+			else break;
+		}
+
+		const Int32 left = (Int32)tree.nodes.GetCount();
+		Node child;
+		child.first = 0;
+		child.count = 0;
+		if (!tree.nodes.Append(child) || !tree.nodes.Append(child)) return false;
+		tree.nodes[r.node].first = left;
+		tree.nodes[r.node].count = 0;
+		Range rl = { left, r.start, mid };
+		Range rr = { left+1, mid, r.end };
+		if (!stack.Append(rl) || !stack.Append(rr)) return false;
+	}
+	return true;
+}
+//-------------------------------------------------------------------------------------------------
+// closest point to p on triangle a,b,c with its barycentric coordinates (Ericson, Real-Time Collision Detection 5.1.5).
+inline Vector UVWTree::ClosestPoint(const Vector &p, const Vector &a, const Vector &b, const Vector &c, Float &u, Float &v, Float &w)
+{
+	const Vector ab = b - a, ac = c - a, ap = p - a;
+	const Float d1 = ab*ap, d2 = ac*ap;
+	if (d1 <= 0.0 && d2 <= 0.0) { u = 1.0; v = 0.0; w = 0.0; return a; }
+	const Vector bp = p - b;
+	const Float d3 = ab*bp, d4 = ac*bp;
+	if (d3 >= 0.0 && d4 <= d3) { u = 0.0; v = 1.0; w = 0.0; return b; }
+	const Float vc = d1*d4 - d3*d2;
+	if (vc <= 0.0 && d1 >= 0.0 && d3 <= 0.0){
+		const Float t = d1 / (d1 - d3);
+		u = 1.0 - t; v = t; w = 0.0;
+		return a + ab*t;
+	}
+	const Vector cp = p - c;
+	const Float d5 = ab*cp, d6 = ac*cp;
+	if (d6 >= 0.0 && d5 <= d6) { u = 0.0; v = 0.0; w = 1.0; return c; }
+	const Float vb = d5*d2 - d1*d6;
+	if (vb <= 0.0 && d2 >= 0.0 && d6 <= 0.0){
+		const Float t = d2 / (d2 - d6);
+		u = 1.0 - t; v = 0.0; w = t;
+		return a + ac*t;
+	}
+	const Float va = d3*d6 - d5*d4;
+	if (va <= 0.0 && (d4 - d3) >= 0.0 && (d5 - d6) >= 0.0){
+		const Float t = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+		u = 0.0; v = 1.0 - t; w = t;
+		return b + (c - b)*t;
+	}
+	const Float denom = va + vb + vc;
+	if (denom == 0.0) { u = 1.0; v = 0.0; w = 0.0; return a; } //degenerated triangle
+	v = vb / denom;
+	w = vc / denom;
+	u = 1.0 - v - w;
+	return a + ab*v + ac*w;
+}
+//-------------------------------------------------------------------------------------------------
+inline Float UVWTree::BoxDistance(const Node &n, const Vector &p)
+{
+	const Float dx = Max(Max(n.min.x - p.x, p.x - n.max.x), 0.0);
+	const Float dy = Max(Max(n.min.y - p.y, p.y - n.max.y), 0.0);
+	const Float dz = Max(Max(n.min.z - p.z, p.z - n.max.z), 0.0);
+	return dx*dx + dy*dy + dz*dz;
+}
+//-------------------------------------------------------------------------------------------------
+inline Bool UVWTree::PointToUV(const Vector &p, Vector *uv, Int32 *poly) const
+{
+	if (!uv || !tree3d.nodes.GetCount()) return false;
+
+	//depth first, nearer child first, subtrees farther away than the best triangle are skipped.
+	Int32 stack[MAX_DEPTH*2];
+	Int32 top = 0;
+	stack[top++] = 0;
+	Float best = MAXVALUE_FLOAT;
+	Int32 best_tri = -1;
+	Float bu = 0.0, bv = 0.0, bw = 0.0;
+	while (top > 0){
+		const Node &n = tree3d.nodes[stack[--top]];
+		if (BoxDistance(n, p) >= best) continue;
+		if (n.count > 0){
+			for (Int32 i=n.first; i<n.first+n.count; ++i){
+				const Triangle &t = tris[tree3d.index[i]];
+				Float u, v, w;
+				const Vector q = ClosestPoint(p, t.p[0], t.p[1], t.p[2], u, v, w);
+				const Float d = (q - p).GetSquaredLength();
+				if (d < best) { best = d; best_tri = tree3d.index[i]; bu = u; bv = v; bw = w; }
+			}
+			continue;
+		}
+		const Float dl = BoxDistance(tree3d.nodes[n.first], p);
+		const Float dr = BoxDistance(tree3d.nodes[n.first+1], p);
+		if (top + 2 > MAX_DEPTH*2) continue; //can not happen with median splits.
+		if (dl < dr) { stack[top++] = n.first+1; stack[top++] = n.first; }
+		else		 { stack[top++] = n.first;	 stack[top++] = n.first+1; }
+	}
+	if (best_tri < 0) return false;
+	const Triangle &t = tris[best_tri];
+	*uv = t.uv[0]*bu + t.uv[1]*bv + t.uv[2]*bw;
+	if (poly) *poly = t.poly;
+	return true;
+}
+//-------------------------------------------------------------------------------------------------
+inline Bool UVWTree::UVToPoint(const Vector &uv, Vector *p, Int32 *poly) const
+{
+	if (!p || !treeUV.nodes.GetCount()) return false;
+	const Float eps = 1e-7; //points on shared edges belong to both triangles.
+
+	Int32 stack[MAX_DEPTH*2];
+	Int32 top = 0;
+	stack[top++] = 0;
+	while (top > 0){
+		const Node &n = treeUV.nodes[stack[--top]];
+		if (uv.x < n.min.x-eps || uv.x > n.max.x+eps || uv.y < n.min.y-eps || uv.y > n.max.y+eps) continue;
+		if (n.count > 0){
+			for (Int32 i=n.first; i<n.first+n.count; ++i){
+				const Triangle &t = tris[treeUV.index[i]];
+				//barycentric coordinates in the uv plane.
+				const Float x0 = t.uv[1].x - t.uv[0].x, y0 = t.uv[1].y - t.uv[0].y;
+				const Float x1 = t.uv[2].x - t.uv[0].x, y1 = t.uv[2].y - t.uv[0].y;
+				const Float den = x0*y1 - x1*y0;
+				if (den == 0.0) continue;
+				const Float px = uv.x - t.uv[0].x, py = uv.y - t.uv[0].y;
+				const Float b1 = (px*y1 - x1*py) / den;
+				const Float b2 = (x0*py - px*y0) / den;
+				if (b1 < -eps || b2 < -eps || b1 + b2 > 1.0 + eps) continue;
+				*p = t.p[0]*(1.0 - b1 - b2) + t.p[1]*b1 + t.p[2]*b2;
+				if (poly) *poly = t.poly;
+				return true;
+			}
+			continue;
+		}
+		if (top + 2 > MAX_DEPTH*2) continue;
+		stack[top++] = n.first;
+		stack[top++] = n.first+1;
+	}
+	return false;
+}
+//-------------------------------------------------------------------------------------------------
+inline Int32 UVWTree::PointsToUV(const Vector *p, Int32 count, Vector *uv) const
+{
+	if (!p || !uv) return 0;
+	Int32 cnt = 0;
+	for (Int32 i=0; i<count; ++i){
+		if (PointToUV(p[i], &uv[i])) ++cnt;
+		else uv[i] = Vector(0.0);
+	}
+	return cnt;
+}
+//-------------------------------------------------------------------------------------------------
+inline Int32 UVWTree::UVsToPoint(const Vector *uv, Int32 count, Vector *p) const
+{
+	if (!p || !uv) return 0;
+	Int32 cnt = 0;
+	for (Int32 i=0; i<count; ++i){
+		if (UVToPoint(uv[i], &p[i])) ++cnt;
+		else p[i] = Vector(0.0);
+	}
+	return cnt;
+}
+
+#endif//_SAMPLER_UVW_REMO_H_